@@ -0,0 +1,225 @@
+#!/usr/bin/env python3
+"""
+Host simulation of the coupled intake/exhaust airflow balancing mode
+Mirrors the calibration learning and duty planner in src/main.cpp against
+two simulated fans whose real curves differ from the controller's model
+(RPM offset at low duty, different slopes and stall points).
+
+The balanced result is compared with two kinds of independent control:
+  - equal 10% steps: both fans on the same UI button, high enough for both targets
+  - tuned 1%:        each fan on its own lowest 1% duty that meets its target,
+                     chosen with perfect knowledge of the true curves
+Only the tuned 1% baseline delivers the same intake and ratio as the balanced
+mode, so it is the fair power comparison. The equal-step baseline shows what a
+user clicking the web UI buttons actually gets.
+"""
+
+import argparse
+import random
+
+# Must match src/main.cpp
+PULSES_PER_REVOLUTION = 1.83
+FAN_RATED_MAX_RPM = 2300
+FAN_MAX_AIRFLOW_CFM = [60.0, 60.0]
+FAN_DEFAULT_MIN_DUTY = 20
+FAN_CALIBRATION_SETTLE_S = 3
+FAN_CALIBRATION_SMOOTHING = 0.25
+FAN_CALIBRATION_STALL_SAMPLES = 2
+FAN_CALIBRATION_MAX_MIN_DUTY = 40
+FAN_CALIBRATION_DECAY_S = 300
+BALANCE_RATIO_TOLERANCE = 0.05
+
+# Simulated hardware (the controller only sees tacho pulses)
+FAN_RATED_POWER_W = 2.88   # Power at rated max RPM; scales with RPM^3 (affinity law)
+SPIN_TIME_CONSTANT_S = 1.5
+
+class SimulatedFan:
+    """RPM = offset + slope * duty above the stall duty (real fans don't pass through 0)"""
+
+    def __init__(self, rpm_offset, rpm_per_percent, stall_duty, max_airflow_cfm):
+        self.rpm_offset = rpm_offset
+        self.rpm_per_percent = rpm_per_percent
+        self.stall_duty = stall_duty
+        self.max_airflow_cfm = max_airflow_cfm
+        self.tacho_dead = False
+        self.rpm = 0.0
+
+    def target_rpm(self, duty):
+        return 0.0 if duty < self.stall_duty else self.rpm_offset + self.rpm_per_percent * duty
+
+    def step(self, duty, dt):
+        self.rpm += (self.target_rpm(duty) - self.rpm) * min(1.0, dt / SPIN_TIME_CONSTANT_S)
+
+    def measured_rpm(self):
+        if self.tacho_dead:
+            return 0
+        # 1-second pulse count window, like measure_rpm()
+        pulses = int(self.rpm / 60 * PULSES_PER_REVOLUTION + random.random())
+        return int(pulses * 60 / PULSES_PER_REVOLUTION)
+
+    def airflow(self, duty):
+        return self.max_airflow_cfm * self.target_rpm(duty) / FAN_RATED_MAX_RPM
+
+    def power(self, duty):
+        return FAN_RATED_POWER_W * (self.target_rpm(duty) / FAN_RATED_MAX_RPM) ** 3
+
+class Controller:
+    """Python port of the FAN CALIBRATION & AIRFLOW BALANCING section"""
+
+    def __init__(self):
+        self.rpm_per_percent = [FAN_RATED_MAX_RPM / 100.0] * 2
+        self.min_duty = [FAN_DEFAULT_MIN_DUTY] * 2
+        self.stall_samples = [0, 0]
+        self.last_min_duty_change = [0, 0]
+        self.duty = [0, 0]
+        self.last_change = [0, 0]
+
+    def update_calibration(self, fan, rpm, now):
+        duty = self.duty[fan]
+        if duty == 0 or now - self.last_change[fan] < FAN_CALIBRATION_SETTLE_S:
+            return
+        if rpm == 0:
+            if duty >= FAN_CALIBRATION_MAX_MIN_DUTY or duty < self.min_duty[fan]:
+                self.stall_samples[fan] = 0
+                return
+            self.stall_samples[fan] += 1
+            if self.stall_samples[fan] >= FAN_CALIBRATION_STALL_SAMPLES:
+                self.stall_samples[fan] = 0
+                self.min_duty[fan] = duty + 1
+                self.last_min_duty_change[fan] = now
+            return
+        self.stall_samples[fan] = 0
+        if duty < self.min_duty[fan]:
+            self.min_duty[fan] = duty
+            self.last_min_duty_change[fan] = now
+        measured = rpm / duty
+        self.rpm_per_percent[fan] += FAN_CALIBRATION_SMOOTHING * (measured - self.rpm_per_percent[fan])
+        if (self.min_duty[fan] > FAN_DEFAULT_MIN_DUTY and
+                now - self.last_min_duty_change[fan] >= FAN_CALIBRATION_DECAY_S):
+            self.min_duty[fan] -= 1
+            self.last_min_duty_change[fan] = now
+
+    def estimate_airflow(self, fan, duty):
+        if duty < self.min_duty[fan]:
+            return 0.0
+        return FAN_MAX_AIRFLOW_CFM[fan] * self.rpm_per_percent[fan] * duty / FAN_RATED_MAX_RPM
+
+    def plan(self, demand, ratio):
+        if demand <= 0:
+            return (0, 0)
+        low, high = ratio * (1 - BALANCE_RATIO_TOLERANCE), ratio * (1 + BALANCE_RATIO_TOLERANCE)
+        best, best_total = None, 201
+        for d1 in range(101):
+            if d1 >= best_total:
+                break
+            intake = self.estimate_airflow(0, d1)
+            if intake < demand:
+                continue
+            for d2 in range(101):
+                if d1 + d2 >= best_total:
+                    break
+                exhaust = self.estimate_airflow(1, d2)
+                if exhaust <= 0 or intake / exhaust > high:
+                    continue
+                if intake / exhaust >= low:
+                    best, best_total = (d1, d2), d1 + d2
+                break
+        return best
+
+    def update(self, demand, ratio, now):
+        max_intake = min(self.estimate_airflow(0, 100), self.estimate_airflow(1, 100) * ratio)
+        plan = self.plan(min(demand, max_intake), ratio)
+        if plan is None:
+            return
+        for fan in range(2):
+            if plan[fan] != self.duty[fan]:
+                self.duty[fan] = plan[fan]
+                self.last_change[fan] = now
+
+def equal_step_baseline(fans, demand, ratio):
+    """Both fans on the same 10% button, lowest step meeting both targets"""
+    for duty in range(0, 101, 10):
+        if fans[0].airflow(duty) >= demand and fans[1].airflow(duty) >= demand / ratio:
+            return (duty, duty)
+    return (100, 100)
+
+def tuned_independent_baseline(fans, intake_target, exhaust_target):
+    """Each fan on its own lowest 1% duty reaching its target (true curves known)"""
+    duties = []
+    for fan, target in zip(fans, (intake_target, exhaust_target)):
+        duties.append(next((d for d in range(101) if fan.airflow(d) >= target), 100))
+    return tuple(duties)
+
+def run_scenario(fans, demand, ratio, seconds):
+    for fan in fans:
+        fan.rpm = 0.0
+    controller = Controller()
+    for now in range(seconds):
+        for fan_index, fan in enumerate(fans):
+            fan.step(controller.duty[fan_index], 1.0)
+            controller.update_calibration(fan_index, fan.measured_rpm(), now)
+        controller.update(demand, ratio, now)
+    return tuple(controller.duty), controller
+
+def describe(fans, duties):
+    intake = fans[0].airflow(duties[0])
+    exhaust = fans[1].airflow(duties[1])
+    power = fans[0].power(duties[0]) + fans[1].power(duties[1])
+    ratio = intake / exhaust if exhaust > 0 else float("inf")
+    return intake, exhaust, ratio, power
+
+def main():
+    parser = argparse.ArgumentParser(description="Airflow balancing host simulation")
+    parser.add_argument("--seconds", type=int, default=120, help="Simulated seconds per scenario")
+    parser.add_argument("--seed", type=int, default=1, help="Random seed for tacho quantization")
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    # Intake fan with a moderate offset; exhaust fan weaker, larger offset, stalls later
+    fans = [SimulatedFan(300, 20.0, 22, FAN_MAX_AIRFLOW_CFM[0]),
+            SimulatedFan(450, 15.5, 28, FAN_MAX_AIRFLOW_CFM[1])]
+    scenarios = [(15, 1.0), (20, 1.1), (25, 1.0), (30, 1.2), (35, 0.9), (40, 1.0), (48, 1.1)]
+
+    print("🌬️  Airflow Balancing Simulation (steady state after "
+          f"{args.seconds}s per scenario)")
+    print("   True curves: fan1 = 300 + 20.0*duty RPM (stall <22%), "
+          "fan2 = 450 + 15.5*duty RPM (stall <28%)")
+    print("=" * 100)
+    print(f"{'Demand':>7}{'Ratio':>7} | {'Mode':<13}{'Duty1':>6}{'Duty2':>6}{'Intake':>8}"
+          f"{'Exhaust':>9}{'Ratio':>7}{'Power W':>9} | {'vs balanced':>11}")
+    totals = {"equal 10%": 0.0, "tuned 1%": 0.0, "balanced": 0.0}
+    worst_ratio_error = 0.0
+    for demand, ratio in scenarios:
+        balanced_duties, controller = run_scenario(fans, demand, ratio, args.seconds)
+        balanced = describe(fans, balanced_duties)
+        worst_ratio_error = max(worst_ratio_error, abs(balanced[2] / ratio - 1))
+        rows = [
+            ("equal 10%", equal_step_baseline(fans, demand, ratio)),
+            # Same intake and exhaust airflow as the balanced mode actually delivered
+            ("tuned 1%", tuned_independent_baseline(fans, balanced[0], balanced[1])),
+            ("balanced", balanced_duties),
+        ]
+        for mode, duties in rows:
+            intake, exhaust, achieved, power = describe(fans, duties)
+            totals[mode] += power
+            delta = "" if mode == "balanced" else f"{100.0 * (power / balanced[3] - 1):+10.1f}%"
+            print(f"{demand:7.1f}{ratio:7.2f} | {mode:<13}{duties[0]:6d}{duties[1]:6d}{intake:8.1f}"
+                  f"{exhaust:9.1f}{achieved:7.2f}{power:9.3f} | {delta:>11}")
+        print(f"{'':15}| learned: fan1 {controller.rpm_per_percent[0]:.1f} rpm/% min {controller.min_duty[0]}%, "
+              f"fan2 {controller.rpm_per_percent[1]:.1f} rpm/% min {controller.min_duty[1]}%")
+    print("=" * 100)
+    print(f"Total power: equal 10% {totals['equal 10%']:.3f} W | tuned 1% {totals['tuned 1%']:.3f} W | "
+          f"balanced {totals['balanced']:.3f} W")
+    print(f"Worst ratio error in balanced mode: {100.0 * worst_ratio_error:.1f}% "
+          f"(tolerance {100.0 * BALANCE_RATIO_TOLERANCE:.0f}%)")
+
+    # Dead exhaust tacho: calibration must not walk the duty up to 100%
+    print()
+    fans[1].tacho_dead = True
+    duties, controller = run_scenario(fans, 25, 1.0, 600)
+    fans[1].tacho_dead = False
+    print(f"🩺 Dead fan 2 tacho for 600s at demand 25 CFM: duties {duties[0]}%/{duties[1]}%, "
+          f"fan 2 min duty {controller.min_duty[1]}% (cap {FAN_CALIBRATION_MAX_MIN_DUTY}%)")
+
+if __name__ == "__main__":
+    main()
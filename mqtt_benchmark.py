@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""
+MQTT Benchmark for ESP32 Dual Fan Controllers
+Measures telemetry message rate and end-to-end command latency through a
+broker (e.g. a local mosquitto). Requires: pip install paho-mqtt
+"""
+
+import argparse
+import json
+import statistics
+import sys
+import threading
+import time
+
+try:
+    import paho.mqtt.client as mqtt
+except ImportError:
+    print("❌ paho-mqtt module not found - install with: pip install paho-mqtt")
+    sys.exit(1)
+
+TOPIC_PREFIX = "fancontroller"  # Must match MQTT_TOPIC_PREFIX in src/main.cpp
+
+def create_client():
+    # paho-mqtt 2.x requires an explicit callback API version
+    if hasattr(mqtt, "CallbackAPIVersion"):
+        return mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+    return mqtt.Client()
+
+class Benchmark:
+    def __init__(self, board):
+        self.board = board
+        self.boards_online = set()
+        self.telemetry_counts = {}
+        self.telemetry_bytes = 0
+        self.pending = {}
+        self.latencies_ms = []
+        self.lock = threading.Lock()
+
+    def on_message(self, client, userdata, msg):
+        parts = msg.topic.split("/")
+        if len(parts) < 3:
+            return
+        board, kind = parts[1], parts[2]
+        with self.lock:
+            if kind == "online" and msg.payload == b"1":
+                self.boards_online.add(board)
+            elif kind == "telemetry":
+                self.telemetry_counts[board] = self.telemetry_counts.get(board, 0) + 1
+                self.telemetry_bytes += len(msg.payload)
+            elif kind == "response":
+                try:
+                    response = json.loads(msg.payload)
+                except ValueError:
+                    return
+                sent = self.pending.pop(response.get("id"), None)
+                if sent is not None:
+                    self.latencies_ms.append((time.perf_counter() - sent) * 1000)
+
+    def send_commands(self, client, count, interval):
+        """Alternate Fan 1 color and ARGB effect commands, timing each round trip"""
+        commands = [
+            ("set_fan1_color", lambda i: {"red": (i * 40) % 256, "green": 0, "blue": 255}),
+            ("set_argb_effect", lambda i: {"effect": 0}),
+        ]
+        for i in range(count):
+            name, payload = commands[i % len(commands)]
+            body = payload(i)
+            body["id"] = i
+            with self.lock:
+                self.pending[i] = time.perf_counter()
+            client.publish(f"{TOPIC_PREFIX}/{self.board}/cmd/{name}", json.dumps(body), qos=0)
+            time.sleep(interval)
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 fan controller MQTT benchmark")
+    parser.add_argument("--broker", default="localhost", help="MQTT broker host")
+    parser.add_argument("--port", type=int, default=1883, help="MQTT broker port")
+    parser.add_argument("--board", help="Board id (MAC without colons); default: first board seen online")
+    parser.add_argument("--duration", type=float, default=30.0, help="Telemetry observation time in seconds")
+    parser.add_argument("--commands", type=int, default=50, help="Number of commands for latency measurement")
+    parser.add_argument("--command-interval", type=float, default=0.2, help="Seconds between commands")
+    args = parser.parse_args()
+
+    bench = Benchmark(args.board)
+    client = create_client()
+    client.on_message = bench.on_message
+    client.connect(args.broker, args.port)
+    client.subscribe(f"{TOPIC_PREFIX}/+/online")
+    client.subscribe(f"{TOPIC_PREFIX}/+/telemetry")
+    client.subscribe(f"{TOPIC_PREFIX}/+/response/+")
+    client.loop_start()
+
+    print(f"📡 Connected to broker {args.broker}:{args.port}")
+
+    if bench.board is None:
+        deadline = time.time() + 5
+        while not bench.boards_online and time.time() < deadline:
+            time.sleep(0.1)
+        if not bench.boards_online:
+            print("❌ No board reported online - is MQTT enabled on the controller (POST /set_mqtt)?")
+            client.loop_stop()
+            sys.exit(1)
+        bench.board = sorted(bench.boards_online)[0]
+    print(f"🎯 Target board: {bench.board}")
+    print("=" * 60)
+
+    start = time.time()
+    bench.send_commands(client, args.commands, args.command_interval)
+    time.sleep(max(1.0, args.duration - (time.time() - start)))
+    elapsed = time.time() - start
+    client.loop_stop()
+    client.disconnect()
+
+    print("📊 Telemetry")
+    for board, count in sorted(bench.telemetry_counts.items()):
+        print(f"   {board}: {count} messages, {count / elapsed:.2f} msg/s")
+    total = sum(bench.telemetry_counts.values())
+    if total:
+        print(f"   Average payload: {bench.telemetry_bytes / total:.1f} bytes")
+
+    print()
+    print("⏱️  Command latency (publish → response)")
+    lost = len(bench.pending)
+    if bench.latencies_ms:
+        latencies = sorted(bench.latencies_ms)
+        p95 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))]
+        print(f"   Responses: {len(latencies)}/{args.commands} ({lost} missing)")
+        print(f"   Min {latencies[0]:.1f} ms | Median {statistics.median(latencies):.1f} ms | "
+              f"P95 {p95:.1f} ms | Max {latencies[-1]:.1f} ms")
+    else:
+        print(f"   No responses received ({lost} commands missing)")
+
+if __name__ == "__main__":
+    main()
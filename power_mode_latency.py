@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""
+Power Mode Tradeoff Report for ESP32 Dual Fan Controller
+Measures HTTP request latency at full performance and when waking the board
+from power-saving idle, alongside the estimated supply current per mode.
+Pair with a USB power meter on the board's supply for measured current.
+
+Every request wakes the board, and the response is built while handling it, so
+the wake counters for a timed /status request are read from a follow-up
+/diagnostics request.
+"""
+
+import argparse
+import statistics
+import sys
+import time
+
+import requests
+
+def set_power_mode(host, mode, idle_timeout_s):
+    response = requests.post(f"http://{host}/set_power_mode",
+                             json={"mode": mode, "idle_timeout_s": idle_timeout_s}, timeout=5)
+    response.raise_for_status()
+    return response.json()
+
+def timed_get(host, path="/status"):
+    start = time.perf_counter()
+    response = requests.get(f"http://{host}{path}", timeout=5)
+    latency_ms = (time.perf_counter() - start) * 1000
+    return latency_ms, response.json()
+
+def summarize(name, latencies, current_ma):
+    latencies = sorted(latencies)
+    p95 = latencies[min(len(latencies) - 1, int(len(latencies) * 0.95))]
+    print(f"   {name:<22} median {statistics.median(latencies):7.1f} ms | p95 {p95:7.1f} ms | "
+          f"max {latencies[-1]:7.1f} ms | est. current {current_ma} mA")
+
+def main():
+    parser = argparse.ArgumentParser(description="Power mode latency / current tradeoff report")
+    parser.add_argument("host", help="ESP32 IP address")
+    parser.add_argument("--samples", type=int, default=10, help="Requests per mode")
+    parser.add_argument("--idle-timeout", type=int, default=2, help="Idle timeout (s) used during the test")
+    args = parser.parse_args()
+
+    try:
+        _, initial = timed_get(args.host, "/diagnostics")
+    except requests.RequestException as e:
+        print(f"❌ Cannot reach http://{args.host}/diagnostics: {e}")
+        sys.exit(1)
+    initial_mode = "auto" if initial.get("power_save_enabled") else "performance"
+    initial_timeout = initial.get("power_idle_timeout_s", 30)
+
+    print(f"⚡ Power mode tradeoff report for {args.host}")
+    print(f"Light sleep supported: {initial.get('power_light_sleep_supported')}")
+    print("=" * 90)
+
+    # Full performance: back-to-back requests, board never idles
+    set_power_mode(args.host, "performance", args.idle_timeout)
+    performance_latencies = []
+    performance_current = None
+    for _ in range(args.samples):
+        latency, _ = timed_get(args.host)
+        performance_latencies.append(latency)
+        _, diagnostics = timed_get(args.host, "/diagnostics")
+        performance_current = diagnostics.get("power_est_current_ma")
+        time.sleep(0.5)
+
+    # Power saving: wait past the idle timeout before every request so each one wakes the board
+    set_power_mode(args.host, "auto", args.idle_timeout)
+    wake_latencies = []
+    idle_current = None
+    loop_wake_us = []
+    _, diagnostics = timed_get(args.host, "/diagnostics")
+    wake_count = diagnostics.get("power_wake_count", 0)
+    for i in range(args.samples):
+        time.sleep(args.idle_timeout + 1.5)
+        latency, status = timed_get(args.host)
+        wake_latencies.append(latency)
+        _, diagnostics = timed_get(args.host, "/diagnostics")
+        woke = diagnostics.get("power_wake_count", 0) > wake_count
+        wake_count = diagnostics.get("power_wake_count", 0)
+        if woke:
+            idle_current = diagnostics.get("power_est_idle_current_ma")
+            loop_wake_us.append(diagnostics.get("power_last_wake_us", 0))
+        print(f"   sample {i + 1:2d}: {latency:7.1f} ms (board was {'idle' if woke else 'not idle'}, "
+              f"answered at {status.get('cpu_mhz')} MHz)")
+
+    _, final = timed_get(args.host, "/diagnostics")
+    set_power_mode(args.host, initial_mode, initial_timeout)
+
+    print()
+    print("📊 Results")
+    summarize("performance", performance_latencies, performance_current)
+    summarize("wake from idle", wake_latencies, idle_current)
+    if loop_wake_us:
+        print(f"   loop() wake after request: median {statistics.median(loop_wake_us) / 1000:.2f} ms "
+              f"({len(loop_wake_us)}/{args.samples} requests woke the board)")
+    print(f"   Wake-ups counted by board: {final.get('power_wake_count')} | "
+          f"time idle since boot: {final.get('power_idle_percent', 0):.1f}%")
+
+if __name__ == "__main__":
+    main()
@@ -1,7 +1,13 @@
 #include <WiFi.h>
+#include <WiFiUdp.h>
 #include <ESPAsyncWebServer.h>
+#include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include <FastLED.h>
+#include <esp_wifi.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
 
 // ====== CONFIGURATION FOR BOARD #1 ======
 // Board #1 from catalog: ESP32 with MAC 44:1d:64:f5:b4:84
@@ -46,20 +52,101 @@ bool ap_mode_active = false;
 #define ARGB_CHIPSET            WS2812B // Standard ARGB chipset
 #define ARGB_COLOR_ORDER        GRB     // Standard color order for WS2812B
 
+// Airflow Balancing Configuration (coupled intake/exhaust mode)
+// Airflow scales linearly with RPM (fan affinity law), so each fan's airflow is
+// estimated as rated_cfm * rpm / rated_rpm using the learned duty -> RPM curve
+#define FAN_RATED_MAX_RPM           2300   // Datasheet max RPM at 100% duty
+#define FAN1_MAX_AIRFLOW_CFM        60.0   // Fan 1 (Intake) rated airflow at max RPM
+#define FAN2_MAX_AIRFLOW_CFM        60.0   // Fan 2 (Exhaust) rated airflow at max RPM
+#define FAN_DEFAULT_MIN_DUTY        FAN_STALL_MIN_PERCENT  // Assumed stall threshold until learned
+#define FAN_CALIBRATION_SETTLE_MS   3000   // Ignore RPM samples this long after a duty change
+#define FAN_CALIBRATION_SMOOTHING   0.25   // EMA weight of each new RPM sample
+#define FAN_CALIBRATION_STALL_SAMPLES 2    // Consecutive 0 RPM readings before raising min duty
+#define FAN_CALIBRATION_MAX_MIN_DUTY  40   // Top of the min duty learning band - 0 RPM at or above this is always a stall fault
+#define FAN_CALIBRATION_DECAY_MS    300000 // Re-probe: lower min duty 1% after 5 min without a stall
+#define BALANCE_RATIO_TOLERANCE     0.05   // Accepted intake:exhaust ratio error (±5%)
+#define BALANCE_UPDATE_INTERVAL_MS  1000   // Re-plan once per RPM measurement window
+
+// Power Management Configuration (idle mode when nobody is talking to the board)
+#define POWER_SAVE_AT_BOOT          false
+#define POWER_IDLE_TIMEOUT_MS       30000  // Quiet period (no HTTP requests or MQTT commands) before going idle
+#define POWER_PERFORMANCE_CPU_MHZ   240
+#define POWER_IDLE_CPU_MHZ          80     // Lowest CPU frequency that keeps WiFi running
+#define POWER_PM_MIN_CPU_MHZ        40     // Dynamic frequency scaling floor, only while both fans are stopped
+#define CONTROL_TICK_MS             100    // loop() period at full performance
+#define POWER_IDLE_TICK_MS          250    // loop() period while idle
+// Typical supply current per state from the ESP32 datasheet (modem-sleep table
+// plus WiFi traffic) - only used for the estimate reported in /status
+#define POWER_EST_PERFORMANCE_MA    110    // 240 MHz, WiFi min modem sleep (Arduino default)
+#define POWER_EST_IDLE_MA           30     // 80 MHz, WiFi max modem sleep
+#define POWER_EST_LIGHT_SLEEP_MA    5      // Automatic light sleep between DTIM beacons
+
+// Web Server Admission Control (protects control timing from misbehaving clients)
+#define ADMISSION_MAX_IN_FLIGHT     8      // Admitted requests not yet disconnected before answering 503
+#define ADMISSION_MAX_CLIENTS       16     // Per-IP buckets tracked (least recently seen is evicted)
+#define ADMISSION_READ_RATE         5.0    // Read requests (page, /status) per second per client
+#define ADMISSION_READ_BURST        10
+#define ADMISSION_WRITE_RATE        4.0    // Control commands per second per client
+#define ADMISSION_WRITE_BURST       8
+
+// UDP Telemetry Configuration (optional multicast stream for fleet collection)
+#define TELEMETRY_ENABLED_AT_BOOT   false            // Enable at runtime via /set_telemetry
+#define TELEMETRY_MULTICAST_GROUP   239, 255, 70, 1  // Multicast group address
+#define TELEMETRY_PORT              5005             // Destination UDP port
+#define TELEMETRY_DEFAULT_RATE_HZ   10               // Datagrams per second
+#define TELEMETRY_MAX_RATE_HZ       10               // Bounded by the 100ms loop() tick
+#define TELEMETRY_KEYFRAME_INTERVAL 10               // Full snapshot every N datagrams
+#define TELEMETRY_PROTOCOL_VERSION  1
+
+// MQTT Configuration (native client - replaces the per-device HTTP polling bridge)
+#define MQTT_ENABLED_AT_BOOT        false
+#define MQTT_BROKER_HOST            "10.0.1.10"      // Change at runtime via /set_mqtt
+#define MQTT_BROKER_PORT            1883
+#define MQTT_TOPIC_PREFIX           "fancontroller"  // Topics: <prefix>/<mac>/...
+#define MQTT_RPM_DEADBAND           50     // Publish when either fan's RPM moves more than this
+#define MQTT_MIN_INTERVAL_MS        1000   // Batch changes: at most one telemetry message per second
+#define MQTT_MAX_INTERVAL_MS        30000  // Publish at least this often even without changes
+#define MQTT_RECONNECT_INTERVAL_MS  5000
+#define MQTT_CONNECT_TIMEOUT_MS     250    // TCP connect timeout - connect_mqtt() runs on the loop task
+#define MQTT_SOCKET_TIMEOUT_S       1      // CONNACK wait when a broker accepts but never answers
+#define MQTT_BROKER_HOST_MAX        64
+#define MQTT_BUFFER_SIZE            512
+
+// Fault Detection
+#define FAN_STALL_MIN_PERCENT   20     // Commanded duty above which 0 RPM counts as a stall (bottom of the learning band)
+#define FAN_FAULT_NONE          0x00
+#define FAN_FAULT_STALL         0x01
+
 // Global variables
 AsyncWebServer server(80);
+WiFiUDP telemetry_udp;
+WiFiClient mqtt_wifi_client;
+PubSubClient mqtt_client(mqtt_wifi_client);
+
+// MQTT state - the broker settings below are owned by loop() (see update_mqtt())
+bool mqtt_enabled = MQTT_ENABLED_AT_BOOT;
+char mqtt_broker_host[MQTT_BROKER_HOST_MAX] = MQTT_BROKER_HOST;
+int mqtt_broker_port = MQTT_BROKER_PORT;
+IPAddress mqtt_broker_ip;
+bool mqtt_broker_resolved = false;
+bool mqtt_is_connected = false;  // Last state seen by update_mqtt() - /status reads this, never the socket
+String mqtt_base_topic;
+unsigned long mqtt_published_count = 0;
+unsigned long mqtt_command_count = 0;
 
 // Fan 1 (Intake) variables
 volatile int fan1_pulse_count = 0;
 volatile int fan1_current_rpm = 0;
 volatile int fan1_current_pwm_percent = 0;
 volatile unsigned long fan1_last_rpm_measurement = 0;
+volatile unsigned long fan1_last_speed_change = 0;
 
 // Fan 2 (Exhaust) variables  
 volatile int fan2_pulse_count = 0;
 volatile int fan2_current_rpm = 0;
 volatile int fan2_current_pwm_percent = 0;
 volatile unsigned long fan2_last_rpm_measurement = 0;
+volatile unsigned long fan2_last_speed_change = 0;
 
 // Debugging variables for interrupt analysis
 volatile unsigned long fan1_last_interrupt_time = 0;
@@ -77,6 +164,7 @@ uint8_t fan2_red = 0, fan2_green = 0, fan2_blue = 0;         // Default: Off (bl
 uint8_t fan1_brightness = ARGB_BRIGHTNESS;
 uint8_t fan2_brightness = ARGB_BRIGHTNESS;
 uint8_t argb_effect = 0;  // 0=solid, 1=breathing, 2=rainbow, etc.
+volatile bool argb_show_pending = false;  // Solid colors changed - push to LEDs on the next loop()
 
 // Forward declarations for ARGB functions
 void set_fan1_color(uint8_t red, uint8_t green, uint8_t blue);
@@ -140,6 +228,9 @@ void set_fan1_speed(int percent) {
     
     ledcWrite(FAN1_PWM_CHANNEL, duty_cycle);
     
+    if (percent != fan1_current_pwm_percent) {
+        fan1_last_speed_change = millis();
+    }
     fan1_current_pwm_percent = percent;
     Serial.printf("✅ Fan 1 PWM set successfully\n");
 }
@@ -155,6 +246,9 @@ void set_fan2_speed(int percent) {
     
     ledcWrite(FAN2_PWM_CHANNEL, duty_cycle);
     
+    if (percent != fan2_current_pwm_percent) {
+        fan2_last_speed_change = millis();
+    }
     fan2_current_pwm_percent = percent;
     Serial.printf("✅ Fan 2 PWM set successfully\n");
 }
@@ -207,7 +301,7 @@ void set_fan1_color(uint8_t red, uint8_t green, uint8_t blue) {
         for (int i = 0; i < LEDS_PER_FAN; i++) {
             fan1_leds[i] = CRGB(red, green, blue);
         }
-        FastLED.show(); // Actually update the LEDs!
+        argb_show_pending = true;  // One FastLED.show() per loop() however many requests arrive
     }
     
     Serial.printf("Fan 1 ARGB: RGB(%d,%d,%d)\n", red, green, blue);
@@ -223,7 +317,7 @@ void set_fan2_color(uint8_t red, uint8_t green, uint8_t blue) {
         for (int i = 0; i < LEDS_PER_FAN; i++) {
             fan2_leds[i] = CRGB(red, green, blue);
         }
-        FastLED.show(); // Actually update the LEDs!
+        argb_show_pending = true;  // One FastLED.show() per loop() however many requests arrive
     }
     
     Serial.printf("Fan 2 ARGB: RGB(%d,%d,%d)\n", red, green, blue);
@@ -238,7 +332,7 @@ void set_fan1_brightness(uint8_t brightness) {
                                (fan1_green * brightness) / 255, 
                                (fan1_blue * brightness) / 255);
         }
-        FastLED.show(); // Actually update the LEDs!
+        argb_show_pending = true;  // One FastLED.show() per loop() however many requests arrive
     }
     Serial.printf("Fan 1 brightness: %d%%\n", (brightness * 100) / 255);
 }
@@ -252,7 +346,7 @@ void set_fan2_brightness(uint8_t brightness) {
                                (fan2_green * brightness) / 255, 
                                (fan2_blue * brightness) / 255);
         }
-        FastLED.show(); // Actually update the LEDs!
+        argb_show_pending = true;  // One FastLED.show() per loop() however many requests arrive
     }
     Serial.printf("Fan 2 brightness: %d%%\n", (brightness * 100) / 255);
 }
@@ -290,8 +384,201 @@ void update_argb_leds() {
             fan2_leds[i] = CHSV(rainbow_hue + (i * 20) + 128, 255, 200); // Offset for variety
         }
         FastLED.show();
+    } else if (argb_show_pending) {
+        // Effect 0 (solid): set_fanX_color/brightness only update the buffers, so
+        // bursts of color requests collapse into a single show() here
+        argb_show_pending = false;
+        FastLED.show();
+    }
+}
+
+// ====== FAN CALIBRATION & AIRFLOW BALANCING ======
+// Each fan's duty -> RPM curve is modelled as linear above a stall threshold
+// (see RPM_Calibration_Guide.md) and learned from settled tacho measurements.
+// The balancing mode turns a single airflow demand plus intake:exhaust ratio
+// into the lowest-total-duty pair of fan speeds that meets both.
+struct FanCalibration {
+    float rpm_per_percent;   // Learned slope of the duty -> RPM curve
+    int min_duty;            // Lowest duty that keeps the fan spinning
+    float max_airflow_cfm;   // Rated airflow at FAN_RATED_MAX_RPM
+    int stall_samples;       // Consecutive 0 RPM readings at a settled duty
+    unsigned long last_min_duty_change;
+};
+
+FanCalibration fan_calibration[2] = {
+    {FAN_RATED_MAX_RPM / 100.0, FAN_DEFAULT_MIN_DUTY, FAN1_MAX_AIRFLOW_CFM, 0, 0},
+    {FAN_RATED_MAX_RPM / 100.0, FAN_DEFAULT_MIN_DUTY, FAN2_MAX_AIRFLOW_CFM, 0, 0},
+};
+
+bool balance_mode_active = false;
+float balance_demand_cfm = 0;      // Required intake (Fan 1) airflow
+float balance_ratio = 1.0;         // Desired intake:exhaust airflow ratio
+bool balance_target_met = false;
+bool balance_demand_limited = false;
+unsigned long balance_last_update = 0;
+
+// Manual speed commands that arrive while balancing is active (or while an
+// earlier one is still staged) are applied by update_airflow_balance() on the
+// loop task, so a plan computed just before the command can't overwrite them.
+portMUX_TYPE balance_mux = portMUX_INITIALIZER_UNLOCKED;
+bool balance_manual_pending = false;
+int balance_manual_duty[2] = {-1, -1};   // -1 = leave that fan unchanged
+
+void update_fan_calibration(int fan, int pwm_percent, int rpm, unsigned long last_speed_change) {
+    if (pwm_percent == 0) return;
+    if (millis() - last_speed_change < FAN_CALIBRATION_SETTLE_MS) return;  // Still spinning up/down
+    
+    FanCalibration &cal = fan_calibration[fan];
+    unsigned long current_time = millis();
+    
+    if (rpm == 0) {
+        // No pulses at a duty this high means a stalled fan or dead tacho - a stall
+        // fault, not a start threshold. Leave the calibration alone so a fault
+        // can't walk the planner's duty up to 100%.
+        if (pwm_percent >= FAN_CALIBRATION_MAX_MIN_DUTY || pwm_percent < cal.min_duty) {
+            cal.stall_samples = 0;
+            return;
+        }
+        
+        // Stalled just above the start threshold - raise it once the stall is
+        // confirmed, so a single tacho glitch doesn't move it
+        if (++cal.stall_samples >= FAN_CALIBRATION_STALL_SAMPLES) {
+            cal.stall_samples = 0;
+            cal.min_duty = pwm_percent + 1;
+            cal.last_min_duty_change = current_time;
+            Serial.printf("Fan %d calibration: stall at %d%%, min duty now %d%%\n", fan + 1, pwm_percent, cal.min_duty);
+        }
+        return;
+    }
+    
+    cal.stall_samples = 0;
+    if (pwm_percent < cal.min_duty) {
+        cal.min_duty = pwm_percent;
+        cal.last_min_duty_change = current_time;
+    }
+    float measured = (float)rpm / pwm_percent;
+    cal.rpm_per_percent += FAN_CALIBRATION_SMOOTHING * (measured - cal.rpm_per_percent);
+    
+    // The planner never commands below min_duty, so a raised threshold would never
+    // be re-learned - let it drift back down while the fan runs without stalling
+    if (cal.min_duty > FAN_DEFAULT_MIN_DUTY && current_time - cal.last_min_duty_change >= FAN_CALIBRATION_DECAY_MS) {
+        cal.min_duty--;
+        cal.last_min_duty_change = current_time;
+    }
+}
+
+float estimate_fan_airflow(int fan, int duty) {
+    const FanCalibration &cal = fan_calibration[fan];
+    if (duty < cal.min_duty) return 0;
+    return cal.max_airflow_cfm * (cal.rpm_per_percent * duty) / FAN_RATED_MAX_RPM;
+}
+
+float rpm_to_airflow(int fan, int rpm) {
+    return fan_calibration[fan].max_airflow_cfm * rpm / FAN_RATED_MAX_RPM;
+}
+
+// Lowest duty1 + duty2 with intake >= demand and intake/exhaust within tolerance of ratio
+bool plan_airflow_balance(float demand_cfm, float ratio, int &best_duty1, int &best_duty2) {
+    if (demand_cfm <= 0) {
+        best_duty1 = 0;
+        best_duty2 = 0;
+        return true;
+    }
+    
+    float ratio_low = ratio * (1.0 - BALANCE_RATIO_TOLERANCE);
+    float ratio_high = ratio * (1.0 + BALANCE_RATIO_TOLERANCE);
+    int best_total = 201;
+    
+    for (int duty1 = 0; duty1 <= 100 && duty1 < best_total; duty1++) {
+        float intake = estimate_fan_airflow(0, duty1);
+        if (intake < demand_cfm) continue;
+        
+        // Exhaust airflow grows with duty2, so the ratio only falls as duty2 rises:
+        // the first duty2 under ratio_high is the only candidate for this duty1
+        for (int duty2 = 0; duty2 <= 100 && duty1 + duty2 < best_total; duty2++) {
+            float exhaust = estimate_fan_airflow(1, duty2);
+            if (exhaust <= 0 || intake / exhaust > ratio_high) continue;
+            if (intake / exhaust >= ratio_low) {
+                best_total = duty1 + duty2;
+                best_duty1 = duty1;
+                best_duty2 = duty2;
+            }
+            break;
+        }
+    }
+    return best_total <= 200;
+}
+
+void set_airflow_balance(bool enabled, float demand_cfm, float ratio) {
+    if (demand_cfm < 0) demand_cfm = 0;
+    if (ratio < 0.25) ratio = 0.25;
+    if (ratio > 4.0) ratio = 4.0;
+    
+    portENTER_CRITICAL(&balance_mux);
+    balance_mode_active = enabled;
+    portEXIT_CRITICAL(&balance_mux);
+    balance_demand_cfm = demand_cfm;
+    balance_ratio = ratio;
+    balance_last_update = millis() - BALANCE_UPDATE_INTERVAL_MS;  // Re-plan on the next loop()
+    
+    Serial.printf("Airflow balance %s: demand %.1f CFM, intake:exhaust %.2f\n",
+                  enabled ? "enabled" : "disabled", demand_cfm, ratio);
+}
+
+// Manual speed commands take the fans back from the airflow balancing mode.
+// Returns true if the speeds were staged for loop(); otherwise the caller sets them.
+bool stage_manual_fan_speeds(int fan1_percent, int fan2_percent) {
+    portENTER_CRITICAL(&balance_mux);
+    bool staged = balance_mode_active || balance_manual_pending;
+    bool was_active = balance_mode_active;
+    if (staged) {
+        balance_mode_active = false;
+        balance_manual_pending = true;
+        if (fan1_percent >= 0) balance_manual_duty[0] = fan1_percent;
+        if (fan2_percent >= 0) balance_manual_duty[1] = fan2_percent;
     }
-    // Effect 0 (solid) is handled by set_fanX_color functions - no need to call FastLED.show() here
+    portEXIT_CRITICAL(&balance_mux);
+    
+    if (was_active) {
+        Serial.println("Airflow balance disabled by manual speed command");
+    }
+    return staged;
+}
+
+void update_airflow_balance() {
+    portENTER_CRITICAL(&balance_mux);
+    bool manual_pending = balance_manual_pending;
+    int manual_duty1 = balance_manual_duty[0];
+    int manual_duty2 = balance_manual_duty[1];
+    balance_manual_pending = false;
+    balance_manual_duty[0] = -1;
+    balance_manual_duty[1] = -1;
+    bool active = balance_mode_active;
+    portEXIT_CRITICAL(&balance_mux);
+    
+    if (manual_pending) {
+        if (manual_duty1 >= 0) set_fan1_speed(manual_duty1);
+        if (manual_duty2 >= 0) set_fan2_speed(manual_duty2);
+        return;
+    }
+    if (!active) return;
+    
+    unsigned long current_time = millis();
+    if (current_time - balance_last_update < BALANCE_UPDATE_INTERVAL_MS) return;
+    balance_last_update = current_time;
+    
+    // Cap the demand at what both fans can deliver together at this ratio
+    float max_intake = min(estimate_fan_airflow(0, 100), estimate_fan_airflow(1, 100) * balance_ratio);
+    float demand = min(balance_demand_cfm, max_intake);
+    balance_demand_limited = demand < balance_demand_cfm;
+    
+    int duty1, duty2;
+    bool plan_found = plan_airflow_balance(demand, balance_ratio, duty1, duty2);
+    balance_target_met = plan_found && !balance_demand_limited;  // A capped demand isn't delivered
+    if (!plan_found) return;  // Keep current speeds until the calibration settles
+    
+    if (duty1 != fan1_current_pwm_percent) set_fan1_speed(duty1);
+    if (duty2 != fan2_current_pwm_percent) set_fan2_speed(duty2);
 }
 
 void measure_rpm() {
@@ -304,8 +591,11 @@ void measure_rpm() {
         fan1_pulse_count = 0;
         interrupts();
         
-        fan1_current_rpm = (fan1_pulses * 60) / PULSES_PER_REVOLUTION;  // Measured PPR for accurate calculation
+        // Scale by the real window length - loop() ticks slower in power-saving idle
+        unsigned long fan1_window_ms = current_time - fan1_last_rpm_measurement;
+        fan1_current_rpm = (fan1_pulses * 60000.0) / (PULSES_PER_REVOLUTION * fan1_window_ms);  // Measured PPR for accurate calculation
         fan1_last_rpm_measurement = current_time;
+        update_fan_calibration(0, fan1_current_pwm_percent, fan1_current_rpm, fan1_last_speed_change);
         
         // Debug output with bounce detection
         noInterrupts();
@@ -314,7 +604,7 @@ void measure_rpm() {
         interrupts();
         
         Serial.printf("Fan 1 (GPIO 18) RPM: %d | Pulses: %d | Bounces: %d | Freq: %.1f Hz\n", 
-                      fan1_current_rpm, fan1_pulses, fan1_bounces, fan1_pulses / 1.0);
+                      fan1_current_rpm, fan1_pulses, fan1_bounces, fan1_pulses * 1000.0 / fan1_window_ms);
     }
     
     // Measure Fan 2 RPM every second  
@@ -324,8 +614,11 @@ void measure_rpm() {
         fan2_pulse_count = 0;
         interrupts();
         
-        fan2_current_rpm = (fan2_pulses * 60) / PULSES_PER_REVOLUTION;  // Measured PPR for accurate calculation
+        // Scale by the real window length - loop() ticks slower in power-saving idle
+        unsigned long fan2_window_ms = current_time - fan2_last_rpm_measurement;
+        fan2_current_rpm = (fan2_pulses * 60000.0) / (PULSES_PER_REVOLUTION * fan2_window_ms);  // Measured PPR for accurate calculation
         fan2_last_rpm_measurement = current_time;
+        update_fan_calibration(1, fan2_current_pwm_percent, fan2_current_rpm, fan2_last_speed_change);
         
         // Debug output with bounce detection
         noInterrupts();
@@ -334,8 +627,350 @@ void measure_rpm() {
         interrupts();
         
         Serial.printf("Fan 2 (GPIO 19) RPM: %d | Pulses: %d | Bounces: %d | Freq: %.1f Hz\n", 
-                      fan2_current_rpm, fan2_pulses, fan2_bounces, fan2_pulses / 1.0);
+                      fan2_current_rpm, fan2_pulses, fan2_bounces, fan2_pulses * 1000.0 / fan2_window_ms);
+    }
+}
+
+// While balancing, the planner runs a fan at its learned min duty, and the
+// decay / default threshold deliberately probe below the real start point. A
+// stall there (duty in the learning band, at or below min_duty) is calibration
+// at work, not a fault - update_fan_calibration() raises min_duty and the
+// planner moves on. A fan that really dies is still flagged once min_duty has
+// climbed to FAN_CALIBRATION_MAX_MIN_DUTY.
+bool fan_calibration_probe(int fan, int pwm_percent) {
+    return balance_mode_active && pwm_percent < FAN_CALIBRATION_MAX_MIN_DUTY &&
+           pwm_percent <= fan_calibration[fan].min_duty;
+}
+
+uint8_t get_fan_fault_flags(int fan, int pwm_percent, int rpm) {
+    uint8_t flags = FAN_FAULT_NONE;
+    if (pwm_percent >= FAN_STALL_MIN_PERCENT && rpm == 0 && !fan_calibration_probe(fan, pwm_percent)) {
+        flags |= FAN_FAULT_STALL;
+    }
+    return flags;
+}
+
+// ====== UDP MULTICAST TELEMETRY ======
+// Datagram layout (little-endian):
+//   [0-1]  magic 'F','T'        [2]  protocol version   [3]  flags (bit0 = keyframe)
+//   [4-7]  sequence number      [8-11] uptime in ms
+//   [12]   datagrams since last keyframe (0 on a keyframe)
+//   [13]   field mask, then one value per set bit in order:
+//          bit0 fan1 rpm, bit1 fan1 duty, bit2 fan1 fault,
+//          bit3 fan2 rpm, bit4 fan2 duty, bit5 fan2 fault
+// Keyframes carry every field (rpm as uint16). Other datagrams carry only the
+// fields that differ from the last keyframe (rpm as int16 delta), so any
+// datagram can be decoded as long as its keyframe arrived - a single lost
+// packet never corrupts the following ones.
+#define TELEMETRY_FLAG_KEYFRAME     0x01
+#define TELEMETRY_FIELD_COUNT       6
+#define TELEMETRY_MAX_DATAGRAM      (14 + 2 * (2 + 1 + 1))
+
+struct TelemetrySnapshot {
+    uint16_t rpm[2];
+    uint8_t duty[2];
+    uint8_t fault[2];
+};
+
+bool telemetry_enabled = TELEMETRY_ENABLED_AT_BOOT;
+int telemetry_rate_hz = TELEMETRY_DEFAULT_RATE_HZ;
+uint32_t telemetry_sequence = 0;
+uint8_t telemetry_since_keyframe = 0;
+unsigned long telemetry_next_send = 0;
+TelemetrySnapshot telemetry_keyframe = {};
+IPAddress telemetry_group(TELEMETRY_MULTICAST_GROUP);
+
+TelemetrySnapshot capture_telemetry_snapshot() {
+    TelemetrySnapshot now;
+    now.rpm[0] = fan1_current_rpm;
+    now.rpm[1] = fan2_current_rpm;
+    now.duty[0] = fan1_current_pwm_percent;
+    now.duty[1] = fan2_current_pwm_percent;
+    now.fault[0] = get_fan_fault_flags(0, fan1_current_pwm_percent, fan1_current_rpm);
+    now.fault[1] = get_fan_fault_flags(1, fan2_current_pwm_percent, fan2_current_rpm);
+    return now;
+}
+
+void set_telemetry(bool enabled, int rate_hz) {
+    if (rate_hz < 1) rate_hz = 1;
+    if (rate_hz > TELEMETRY_MAX_RATE_HZ) rate_hz = TELEMETRY_MAX_RATE_HZ;
+    
+    telemetry_enabled = enabled;
+    telemetry_rate_hz = rate_hz;
+    telemetry_since_keyframe = 0;  // Next datagram is a keyframe so receivers resync
+    telemetry_next_send = millis();
+    
+    Serial.printf("UDP telemetry %s: %s:%d @ %d Hz\n", enabled ? "enabled" : "disabled",
+                  telemetry_group.toString().c_str(), TELEMETRY_PORT, rate_hz);
+}
+
+size_t encode_telemetry_datagram(uint8_t *buffer, const TelemetrySnapshot &now, bool keyframe) {
+    size_t pos = 0;
+    uint32_t uptime_ms = millis();
+    
+    buffer[pos++] = 'F';
+    buffer[pos++] = 'T';
+    buffer[pos++] = TELEMETRY_PROTOCOL_VERSION;
+    buffer[pos++] = keyframe ? TELEMETRY_FLAG_KEYFRAME : 0;
+    for (int i = 0; i < 4; i++) buffer[pos++] = (telemetry_sequence >> (8 * i)) & 0xFF;
+    for (int i = 0; i < 4; i++) buffer[pos++] = (uptime_ms >> (8 * i)) & 0xFF;
+    buffer[pos++] = keyframe ? 0 : telemetry_since_keyframe;
+    
+    size_t mask_pos = pos++;
+    uint8_t mask = 0;
+    
+    for (int fan = 0; fan < 2; fan++) {
+        uint8_t bit = fan * 3;
+        
+        if (keyframe || now.rpm[fan] != telemetry_keyframe.rpm[fan]) {
+            uint16_t value = keyframe ? now.rpm[fan]
+                                      : (uint16_t)((int16_t)now.rpm[fan] - (int16_t)telemetry_keyframe.rpm[fan]);
+            buffer[pos++] = value & 0xFF;
+            buffer[pos++] = value >> 8;
+            mask |= 1 << bit;
+        }
+        if (keyframe || now.duty[fan] != telemetry_keyframe.duty[fan]) {
+            buffer[pos++] = now.duty[fan];
+            mask |= 1 << (bit + 1);
+        }
+        if (keyframe || now.fault[fan] != telemetry_keyframe.fault[fan]) {
+            buffer[pos++] = now.fault[fan];
+            mask |= 1 << (bit + 2);
+        }
     }
+    
+    buffer[mask_pos] = mask;
+    return pos;
+}
+
+void update_telemetry() {
+    if (!telemetry_enabled) return;
+    if (WiFi.status() != WL_CONNECTED && !ap_mode_active) return;
+    
+    unsigned long current_time = millis();
+    if ((long)(current_time - telemetry_next_send) < 0) return;
+    
+    // Fixed schedule (not "now + interval") so loop jitter doesn't lower the average rate
+    unsigned long interval = 1000 / telemetry_rate_hz;
+    telemetry_next_send += interval;
+    if ((long)(current_time - telemetry_next_send) > (long)interval) {
+        telemetry_next_send = current_time + interval;  // Fell far behind - don't burst
+    }
+    
+    TelemetrySnapshot now = capture_telemetry_snapshot();
+    bool keyframe = (telemetry_since_keyframe == 0);
+    uint8_t buffer[TELEMETRY_MAX_DATAGRAM];
+    size_t len = encode_telemetry_datagram(buffer, now, keyframe);
+    
+    telemetry_udp.beginPacket(telemetry_group, TELEMETRY_PORT);
+    telemetry_udp.write(buffer, len);
+    telemetry_udp.endPacket();
+    
+    if (keyframe) {
+        telemetry_keyframe = now;
+    }
+    telemetry_sequence++;
+    telemetry_since_keyframe = (telemetry_since_keyframe + 1) % TELEMETRY_KEYFRAME_INTERVAL;
+}
+
+// ====== POWER MANAGEMENT ======
+// Idle mode drops the CPU to 80 MHz, enables WiFi max modem sleep and stretches
+// the loop() tick. When the IDF power management component is available with
+// tickless idle (CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE - without
+// the latter esp_pm_configure() rejects light sleep), automatic light sleep is
+// also allowed, but only while both
+// fans are stopped: light sleep gates the GPIO interrupts (and PCNT clock) that
+// count tacho pulses, so it is never used while there is RPM to measure.
+// Any HTTP request, MQTT command or fan fault switches straight back to full
+// performance.
+enum PowerState {
+    POWER_PERFORMANCE,
+    POWER_IDLE
+};
+
+bool power_save_enabled = POWER_SAVE_AT_BOOT;
+unsigned long power_idle_timeout_ms = POWER_IDLE_TIMEOUT_MS;
+PowerState power_state = POWER_PERFORMANCE;
+bool power_light_sleep_active = false;
+bool power_pm_failed = false;   // esp_pm_configure() was rejected - use setCpuFrequencyMhz() only
+TaskHandle_t loop_task_handle = NULL;
+
+volatile unsigned long power_last_request = 0;
+volatile bool power_wake_requested = false;
+volatile unsigned long power_wake_requested_at = 0;   // micros() when a request arrived while idle
+unsigned long power_last_wake_latency_us = 0;
+unsigned long power_wake_count = 0;
+
+unsigned long power_state_since = 0;
+unsigned long power_idle_total_ms = 0;
+
+// Called from the AsyncTCP task for every HTTP request and from loop() for
+// every MQTT command (the notify then just skips the next tick wait)
+void power_note_request() {
+    power_last_request = millis();
+    if (power_state == POWER_IDLE && !power_wake_requested) {
+        power_wake_requested_at = micros();
+        power_wake_requested = true;
+        if (loop_task_handle != NULL) {
+            xTaskNotifyGive(loop_task_handle);  // Cut the idle tick short
+        }
+    }
+}
+
+bool power_light_sleep_supported() {
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    return !power_pm_failed;
+#else
+    return false;
+#endif
+}
+
+void apply_power_state(PowerState state, bool light_sleep) {
+    unsigned long current_time = millis();
+    if (power_state == POWER_IDLE) {
+        power_idle_total_ms += current_time - power_state_since;
+    }
+    power_state_since = current_time;
+    power_state = state;
+    
+    int cpu_mhz = (state == POWER_IDLE) ? POWER_IDLE_CPU_MHZ : POWER_PERFORMANCE_CPU_MHZ;
+    bool frequency_set = false;
+#if CONFIG_PM_ENABLE
+    if (!power_pm_failed) {
+        esp_pm_config_esp32_t pm_config = {};
+        pm_config.max_freq_mhz = cpu_mhz;
+        // Below 80 MHz the APB clock drops too, and the LEDC timer driving the 25kHz
+        // fan PWM runs from APB - so only scale that low when light sleep is allowed,
+        // i.e. both fans are stopped
+        pm_config.min_freq_mhz = light_sleep ? POWER_PM_MIN_CPU_MHZ : cpu_mhz;
+        pm_config.light_sleep_enable = light_sleep;
+        esp_err_t err = esp_pm_configure(&pm_config);
+        if (err == ESP_OK) {
+            frequency_set = true;
+        } else {
+            // A rejected config changes nothing - don't retry it every tick
+            Serial.printf("Power mode: esp_pm_configure failed (%s), using fixed CPU frequency\n", esp_err_to_name(err));
+            power_pm_failed = true;
+        }
+    }
+#endif
+    if (!frequency_set) {
+        light_sleep = false;
+        setCpuFrequencyMhz(cpu_mhz);
+    }
+    power_light_sleep_active = light_sleep;
+    
+    // Performance keeps the Arduino default (min modem sleep) rather than
+    // turning power save off, so boards not using power saving draw no extra current
+    if (!ap_mode_active) {
+        WiFi.setSleep(state == POWER_IDLE ? WIFI_PS_MAX_MODEM : WIFI_PS_MIN_MODEM);
+    }
+    
+    Serial.printf("Power mode: %s (%d MHz%s)\n", state == POWER_IDLE ? "idle" : "performance",
+                  cpu_mhz, light_sleep ? ", light sleep" : "");
+}
+
+void set_power_save(bool enabled, unsigned long idle_timeout_ms) {
+    power_save_enabled = enabled;
+    power_idle_timeout_ms = idle_timeout_ms;
+    power_last_request = millis();
+    Serial.printf("Power saving %s (idle after %lus without requests or commands)\n",
+                  enabled ? "enabled" : "disabled", idle_timeout_ms / 1000);
+}
+
+int power_estimated_current_ma(PowerState state, bool light_sleep) {
+    if (state == POWER_PERFORMANCE) return POWER_EST_PERFORMANCE_MA;
+    return light_sleep ? POWER_EST_LIGHT_SLEEP_MA : POWER_EST_IDLE_MA;
+}
+
+float power_idle_percent() {
+    unsigned long idle_ms = power_idle_total_ms;
+    if (power_state == POWER_IDLE) {
+        idle_ms += millis() - power_state_since;
+    }
+    return millis() == 0 ? 0 : 100.0 * idle_ms / millis();
+}
+
+void update_power_mode() {
+    bool fault = get_fan_fault_flags(0, fan1_current_pwm_percent, fan1_current_rpm) != FAN_FAULT_NONE ||
+                 get_fan_fault_flags(1, fan2_current_pwm_percent, fan2_current_rpm) != FAN_FAULT_NONE;
+    
+    if (power_wake_requested) {
+        power_wake_requested = false;
+        power_last_wake_latency_us = micros() - power_wake_requested_at;
+        power_wake_count++;
+    }
+    
+    // ARGB effects animate every tick, so they need full-rate loop() too
+    bool idle_allowed = power_save_enabled && !fault && argb_effect == 0 &&
+                        millis() - power_last_request >= power_idle_timeout_ms;
+    bool light_sleep = idle_allowed && power_light_sleep_supported() &&
+                       fan1_current_pwm_percent == 0 && fan2_current_pwm_percent == 0;
+    
+    if (idle_allowed) {
+        if (power_state != POWER_IDLE || light_sleep != power_light_sleep_active) {
+            apply_power_state(POWER_IDLE, light_sleep);
+        }
+    } else if (power_state != POWER_PERFORMANCE) {
+        apply_power_state(POWER_PERFORMANCE, false);
+    }
+}
+
+unsigned long control_tick_ms() {
+    if (power_state != POWER_IDLE) return CONTROL_TICK_MS;
+    
+    // Don't let the idle tick throttle an enabled telemetry stream
+    unsigned long tick = POWER_IDLE_TICK_MS;
+    if (telemetry_enabled && 1000UL / telemetry_rate_hz < tick) {
+        tick = 1000UL / telemetry_rate_hz;
+    }
+    return tick;
+}
+
+// ====== CONTROL LOOP TIMING ======
+// Tracks how late loop() wakes relative to its scheduled tick and how long each
+// pass takes, so web server load can be checked against control timing.
+// loop() updates the counters while /diagnostics and /reset_stats read or clear
+// them from the AsyncTCP task, so every access goes through loop_timing_mux
+// (loop_late_total_us is 64-bit and can't be read or written atomically).
+portMUX_TYPE loop_timing_mux = portMUX_INITIALIZER_UNLOCKED;
+unsigned long loop_wait_started_us = 0;
+unsigned long loop_wait_tick_us = 0;
+unsigned long loop_late_max_us = 0;
+unsigned long loop_work_max_us = 0;
+uint64_t loop_late_total_us = 0;
+unsigned long loop_tick_count = 0;
+
+void reset_loop_timing() {
+    portENTER_CRITICAL(&loop_timing_mux);
+    loop_late_max_us = 0;
+    loop_work_max_us = 0;
+    loop_late_total_us = 0;
+    loop_tick_count = 0;
+    portEXIT_CRITICAL(&loop_timing_mux);
+}
+
+void loop_timing_tick_start(unsigned long now_us) {
+    if (loop_wait_started_us == 0) return;
+    
+    // Early wake-ups (request notifications) count as on time
+    long late_us = (long)(now_us - loop_wait_started_us - loop_wait_tick_us);
+    if (late_us < 0) late_us = 0;
+    
+    portENTER_CRITICAL(&loop_timing_mux);
+    loop_late_total_us += late_us;
+    loop_tick_count++;
+    if ((unsigned long)late_us > loop_late_max_us) loop_late_max_us = late_us;
+    portEXIT_CRITICAL(&loop_timing_mux);
+}
+
+void loop_timing_tick_end(unsigned long start_us, unsigned long tick_ms) {
+    unsigned long now_us = micros();
+    portENTER_CRITICAL(&loop_timing_mux);
+    if (now_us - start_us > loop_work_max_us) loop_work_max_us = now_us - start_us;
+    portEXIT_CRITICAL(&loop_timing_mux);
+    loop_wait_started_us = now_us;
+    loop_wait_tick_us = tick_ms * 1000;
 }
 
 // ====== WIFI CONNECTION WITH AP FALLBACK ======
@@ -384,9 +1019,149 @@ void init_wifi() {
 }
 
 // ====== WEB SERVER & API ======
-String get_status_json() {
+// Clients may ask for MessagePack instead of JSON via Accept / Content-Type.
+// JSON remains the default so the web UI and existing scripts are unaffected.
+#define MSGPACK_CONTENT_TYPE    "application/msgpack"
+
+bool header_is_msgpack(const String& value) {
+    // Matches both application/msgpack and application/x-msgpack
+    return value.indexOf("msgpack") >= 0;
+}
+
+bool request_body_is_msgpack(AsyncWebServerRequest *request) {
+    return header_is_msgpack(request->contentType());
+}
+
+bool request_wants_msgpack(AsyncWebServerRequest *request) {
+    if (request->hasHeader("Accept")) {
+        const String& accept = request->getHeader("Accept")->value();
+        if (header_is_msgpack(accept)) return true;
+        if (accept.indexOf("json") >= 0) return false;
+    }
+    // No explicit preference (missing or */*): answer in the encoding the client sent
+    return request_body_is_msgpack(request);
+}
+
+DeserializationError parse_request_body(AsyncWebServerRequest *request, JsonDocument &doc, uint8_t *data, size_t len) {
+    DeserializationError error = request_body_is_msgpack(request)
+        ? deserializeMsgPack(doc, data, len)
+        : deserializeJson(doc, data, len);
+    
+    if (error) {
+        Serial.printf("Request body parse error on %s: %s\n", request->url().c_str(), error.c_str());
+    }
+    return error;
+}
+
+void send_document(AsyncWebServerRequest *request, JsonDocument &doc, int code = 200) {
+    if (request_wants_msgpack(request)) {
+        AsyncResponseStream *response = request->beginResponseStream(MSGPACK_CONTENT_TYPE);
+        response->setCode(code);
+        serializeMsgPack(doc, *response);
+        request->send(response);
+    } else {
+        String response_str;
+        serializeJson(doc, response_str);
+        request->send(code, "application/json", response_str);
+    }
+}
+
+// ====== ADMISSION CONTROL ======
+// Every request passes admit_request() before its handler runs. Clients that
+// exceed their per-IP token bucket for the route class get 429. The 503 cap is
+// on in-flight requests - admitted but not yet disconnected - since requests are
+// only seen here once parsed; raw TCP connections are bounded by AsyncTCP itself.
+// Both rejections carry Retry-After. The buckets and admission counters are only
+// touched by HTTP handlers on the AsyncTCP task (reset_stats is HTTP-only for
+// that reason), so they need no locking.
+enum RouteClass {
+    ROUTE_READ,
+    ROUTE_WRITE
+};
+
+struct ClientBucket {
+    uint32_t ip;
+    unsigned long last_seen;
+    unsigned long last_refill;
+    float tokens[2];          // Indexed by RouteClass
+};
+
+ClientBucket admission_clients[ADMISSION_MAX_CLIENTS] = {};
+int admission_in_flight = 0;
+unsigned long admission_admitted = 0;
+unsigned long admission_rejected_busy = 0;
+unsigned long admission_rejected_rate[2] = {0, 0};
+
+const float admission_rate[2] = {ADMISSION_READ_RATE, ADMISSION_WRITE_RATE};
+const float admission_burst[2] = {ADMISSION_READ_BURST, ADMISSION_WRITE_BURST};
+
+ClientBucket &get_client_bucket(uint32_t ip, unsigned long current_time) {
+    ClientBucket *oldest = &admission_clients[0];
+    for (ClientBucket &bucket : admission_clients) {
+        if (bucket.ip == ip && bucket.last_seen != 0) return bucket;
+        if (bucket.last_seen < oldest->last_seen) oldest = &bucket;
+    }
+    
+    // New client (or evicting the least recently seen one) starts with full buckets
+    oldest->ip = ip;
+    oldest->last_refill = current_time;
+    oldest->tokens[ROUTE_READ] = ADMISSION_READ_BURST;
+    oldest->tokens[ROUTE_WRITE] = ADMISSION_WRITE_BURST;
+    return *oldest;
+}
+
+void reject_request(AsyncWebServerRequest *request, int code, const char* error, int retry_after_s) {
     JsonDocument doc;
+    doc["success"] = false;
+    doc["error"] = error;
+    doc["retry_after"] = retry_after_s;
+    
+    String body;
+    serializeJson(doc, body);
+    AsyncWebServerResponse *response = request->beginResponse(code, "application/json", body);
+    response->addHeader("Retry-After", String(retry_after_s));
+    request->send(response);
+}
+
+bool admit_request(AsyncWebServerRequest *request, RouteClass route_class) {
+    power_note_request();
     
+    if (admission_in_flight >= ADMISSION_MAX_IN_FLIGHT) {
+        admission_rejected_busy++;
+        reject_request(request, 503, "busy", 1);
+        return false;
+    }
+    
+    unsigned long current_time = millis();
+    ClientBucket &bucket = get_client_bucket((uint32_t)request->client()->remoteIP(), current_time);
+    bucket.last_seen = current_time;
+    
+    // Refill both classes for the elapsed time
+    float elapsed_s = (current_time - bucket.last_refill) / 1000.0;
+    bucket.last_refill = current_time;
+    for (int c = 0; c < 2; c++) {
+        bucket.tokens[c] = min(admission_burst[c], bucket.tokens[c] + elapsed_s * admission_rate[c]);
+    }
+    
+    if (bucket.tokens[route_class] < 1.0) {
+        admission_rejected_rate[route_class]++;
+        int retry_after_s = ceil((1.0 - bucket.tokens[route_class]) / admission_rate[route_class]);
+        reject_request(request, 429, "rate_limited", max(retry_after_s, 1));
+        return false;
+    }
+    bucket.tokens[route_class] -= 1.0;
+    
+    admission_admitted++;
+    admission_in_flight++;
+    request->onDisconnect([]() {
+        admission_in_flight--;
+    });
+    return true;
+}
+
+// /status carries live state only, so the dashboards polling it stay small.
+// Settings, calibration and counters are in build_diagnostics_doc().
+void build_status_doc(JsonDocument &doc) {
     // Dual Fan Status
     doc["fan1_speed"] = fan1_current_pwm_percent;
     doc["fan1_rpm"] = fan1_current_rpm;
@@ -408,6 +1183,19 @@ String get_status_json() {
     doc["fan2_brightness"] = (fan2_brightness * 100) / 255;  // Convert to percentage
     doc["argb_effect"] = argb_effect;
     
+    // Fault and Telemetry Status
+    doc["fan1_fault"] = get_fan_fault_flags(0, fan1_current_pwm_percent, fan1_current_rpm);
+    doc["fan2_fault"] = get_fan_fault_flags(1, fan2_current_pwm_percent, fan2_current_rpm);
+    doc["fan1_airflow_cfm"] = rpm_to_airflow(0, fan1_current_rpm);
+    doc["fan2_airflow_cfm"] = rpm_to_airflow(1, fan2_current_rpm);
+    
+    // Live Airflow Balancing, Power and MQTT State (settings and counters are in /diagnostics)
+    doc["balance_active"] = balance_mode_active;
+    doc["balance_target_met"] = balance_target_met;
+    doc["power_state"] = power_state == POWER_IDLE ? "idle" : "performance";
+    doc["cpu_mhz"] = getCpuFrequencyMhz();
+    doc["mqtt_connected"] = mqtt_is_connected;
+    
     // Legacy single fan fields (for backward compatibility)
     doc["fan_speed"] = fan1_current_pwm_percent;  // Default to Fan 1
     doc["fan_rpm"] = fan1_current_rpm;           // Default to Fan 1
@@ -426,10 +1214,490 @@ String get_status_json() {
         doc["ip_address"] = WiFi.localIP().toString();
         doc["connected_clients"] = "N/A";
     }
+}
+
+void build_diagnostics_doc(JsonDocument &doc) {
+    // Fan Calibration
+    doc["fan1_min_duty"] = fan_calibration[0].min_duty;
+    doc["fan2_min_duty"] = fan_calibration[1].min_duty;
+    doc["fan1_rpm_per_percent"] = fan_calibration[0].rpm_per_percent;
+    doc["fan2_rpm_per_percent"] = fan_calibration[1].rpm_per_percent;
+    
+    // Airflow Balancing Settings
+    doc["balance_demand_cfm"] = balance_demand_cfm;
+    doc["balance_ratio"] = balance_ratio;
+    doc["balance_demand_limited"] = balance_demand_limited;
+    
+    // Power Management Settings and Counters
+    doc["power_save_enabled"] = power_save_enabled;
+    doc["power_idle_timeout_s"] = power_idle_timeout_ms / 1000;
+    doc["power_light_sleep_supported"] = power_light_sleep_supported();
+    doc["power_light_sleep"] = power_light_sleep_active;
+    doc["power_idle_percent"] = power_idle_percent();
+    doc["power_est_current_ma"] = power_estimated_current_ma(power_state, power_light_sleep_active);
+    // What idle would draw with the fans as they are now (requests always see performance)
+    doc["power_est_idle_current_ma"] = power_estimated_current_ma(POWER_IDLE,
+        power_light_sleep_supported() && fan1_current_pwm_percent == 0 && fan2_current_pwm_percent == 0);
+    doc["power_wake_count"] = power_wake_count;
+    doc["power_last_wake_us"] = power_last_wake_latency_us;
+    
+    // Web Server Load and Control Loop Timing
+    doc["admission_admitted"] = admission_admitted;
+    doc["admission_in_flight"] = admission_in_flight;
+    doc["admission_rejected_busy"] = admission_rejected_busy;
+    doc["admission_rejected_read"] = admission_rejected_rate[ROUTE_READ];
+    doc["admission_rejected_write"] = admission_rejected_rate[ROUTE_WRITE];
+    portENTER_CRITICAL(&loop_timing_mux);
+    unsigned long late_max_us = loop_late_max_us;
+    unsigned long late_avg_us = loop_tick_count == 0 ? 0 : (unsigned long)(loop_late_total_us / loop_tick_count);
+    unsigned long work_max_us = loop_work_max_us;
+    portEXIT_CRITICAL(&loop_timing_mux);
+    doc["loop_late_max_us"] = late_max_us;
+    doc["loop_late_avg_us"] = late_avg_us;
+    doc["loop_work_max_us"] = work_max_us;
+    
+    // Telemetry and MQTT
+    doc["telemetry_enabled"] = telemetry_enabled;
+    doc["telemetry_rate_hz"] = telemetry_rate_hz;
+    doc["telemetry_sequence"] = telemetry_sequence;
+    doc["mqtt_enabled"] = mqtt_enabled;
+    doc["mqtt_published"] = mqtt_published_count;
+    doc["mqtt_commands"] = mqtt_command_count;
+}
+
+// ====== COMMAND HANDLERS ======
+// Shared by the HTTP control endpoints and the MQTT command topics, so both
+// transports apply commands and build responses identically.
+typedef void (*CommandHandler)(JsonDocument &doc, JsonDocument &response);
+
+struct CommandRoute {
+    const char* name;        // HTTP path "/<name>" and MQTT topic "<base>/cmd/<name>"
+    CommandHandler handler;
+};
+
+// Set fan speeds (dual fan support + legacy single fan field)
+void handle_set_speed(JsonDocument &doc, JsonDocument &response) {
+    response["success"] = true;
+    int fan1_speed = -1;
+    int fan2_speed = -1;
+    
+    // Handle legacy single fan control (defaults to Fan 1)
+    if (doc.containsKey("speed")) {
+        fan1_speed = doc["speed"];
+        response["speed"] = fan1_speed;
+        response["fan"] = "fan1";
+    }
+    
+    // Handle individual fan control
+    if (doc.containsKey("fan1_speed")) {
+        fan1_speed = doc["fan1_speed"];
+        response["fan1_speed"] = fan1_speed;
+    }
+    
+    if (doc.containsKey("fan2_speed")) {
+        fan2_speed = doc["fan2_speed"];
+        response["fan2_speed"] = fan2_speed;
+    }
+    
+    // Negative means "unchanged" to the staging, so clamp what was actually given
+    if (doc.containsKey("speed") || doc.containsKey("fan1_speed")) fan1_speed = constrain(fan1_speed, 0, 100);
+    if (doc.containsKey("fan2_speed")) fan2_speed = constrain(fan2_speed, 0, 100);
+    if (!stage_manual_fan_speeds(fan1_speed, fan2_speed)) {
+        if (fan1_speed >= 0) set_fan1_speed(fan1_speed);
+        if (fan2_speed >= 0) set_fan2_speed(fan2_speed);
+    }
+}
+
+// Individual fan control
+void handle_set_fan1(JsonDocument &doc, JsonDocument &response) {
+    int speed = doc["speed"];
+    if (!stage_manual_fan_speeds(constrain(speed, 0, 100), -1)) set_fan1_speed(speed);
+    
+    response["success"] = true;
+    response["fan"] = "fan1";
+    response["speed"] = speed;
+}
+
+void handle_set_fan2(JsonDocument &doc, JsonDocument &response) {
+    int speed = doc["speed"];
+    if (!stage_manual_fan_speeds(-1, constrain(speed, 0, 100))) set_fan2_speed(speed);
+    
+    response["success"] = true;
+    response["fan"] = "fan2";
+    response["speed"] = speed;
+}
+
+// Fan 1 ARGB Color Control
+void handle_set_fan1_color(JsonDocument &doc, JsonDocument &response) {
+    uint8_t red = doc["red"];
+    uint8_t green = doc["green"];
+    uint8_t blue = doc["blue"];
+    
+    set_fan1_color(red, green, blue);
+    
+    response["success"] = true;
+    response["fan"] = "fan1";
+    response["red"] = red;
+    response["green"] = green; 
+    response["blue"] = blue;
+}
+
+// Fan 2 ARGB Color Control
+void handle_set_fan2_color(JsonDocument &doc, JsonDocument &response) {
+    uint8_t red = doc["red"];
+    uint8_t green = doc["green"];
+    uint8_t blue = doc["blue"];
+    
+    set_fan2_color(red, green, blue);
+    
+    response["success"] = true;
+    response["fan"] = "fan2";
+    response["red"] = red;
+    response["green"] = green;
+    response["blue"] = blue;
+}
+
+// Fan 1 Brightness Control
+void handle_set_fan1_brightness(JsonDocument &doc, JsonDocument &response) {
+    int brightness_percent = doc["brightness"];
+    uint8_t brightness = (brightness_percent * 255) / 100;  // Convert percentage to 0-255
+    
+    set_fan1_brightness(brightness);
+    
+    response["success"] = true;
+    response["fan"] = "fan1";
+    response["brightness"] = brightness_percent;
+}
+
+// Fan 2 Brightness Control
+void handle_set_fan2_brightness(JsonDocument &doc, JsonDocument &response) {
+    int brightness_percent = doc["brightness"];
+    uint8_t brightness = (brightness_percent * 255) / 100;  // Convert percentage to 0-255
+    
+    set_fan2_brightness(brightness);
+    
+    response["success"] = true;
+    response["fan"] = "fan2";  
+    response["brightness"] = brightness_percent;
+}
+
+// ARGB Effect Control
+void handle_set_argb_effect(JsonDocument &doc, JsonDocument &response) {
+    int effect = doc["effect"];
+    argb_effect = effect;
+    
+    Serial.printf("ARGB effect changed to: %d\n", effect);
+    
+    response["success"] = true;
+    response["effect"] = effect;
+}
+
+// UDP Telemetry Control
+void handle_set_telemetry(JsonDocument &doc, JsonDocument &response) {
+    bool enabled = doc["enabled"] | telemetry_enabled;
+    int rate_hz = doc["rate_hz"] | telemetry_rate_hz;
+    set_telemetry(enabled, rate_hz);
+    
+    response["success"] = true;
+    response["enabled"] = telemetry_enabled;
+    response["rate_hz"] = telemetry_rate_hz;
+    response["group"] = telemetry_group.toString();
+    response["port"] = TELEMETRY_PORT;
+}
+
+// Coupled Intake/Exhaust Airflow Balancing
+void handle_set_airflow_balance(JsonDocument &doc, JsonDocument &response) {
+    bool enabled = doc["enabled"] | true;
+    float demand_cfm = doc["demand_cfm"] | balance_demand_cfm;
+    float ratio = doc["ratio"] | balance_ratio;
+    set_airflow_balance(enabled, demand_cfm, ratio);
+    
+    response["success"] = true;
+    response["enabled"] = balance_mode_active;
+    response["demand_cfm"] = balance_demand_cfm;
+    response["ratio"] = balance_ratio;
+}
+
+// Power Saving Mode ("auto" = idle when quiet, "performance" = always full speed)
+void handle_set_power_mode(JsonDocument &doc, JsonDocument &response) {
+    String mode = doc["mode"] | (power_save_enabled ? "auto" : "performance");
+    unsigned long idle_timeout_s = doc["idle_timeout_s"] | (power_idle_timeout_ms / 1000);
+    if (idle_timeout_s < 1) idle_timeout_s = 1;
+    
+    set_power_save(mode == "auto", idle_timeout_s * 1000);
+    
+    response["success"] = true;
+    response["mode"] = power_save_enabled ? "auto" : "performance";
+    response["idle_timeout_s"] = power_idle_timeout_ms / 1000;
+    response["light_sleep_supported"] = power_light_sleep_supported();
+}
+
+// Reset loop timing and admission counters (e.g. between load test runs).
+// HTTP only (not in command_routes): the admission counters belong to the
+// AsyncTCP task, and MQTT commands run on the loop task.
+void handle_reset_stats(JsonDocument &response) {
+    reset_loop_timing();
+    admission_admitted = 0;
+    admission_rejected_busy = 0;
+    admission_rejected_rate[ROUTE_READ] = 0;
+    admission_rejected_rate[ROUTE_WRITE] = 0;
+    
+    response["success"] = true;
+}
+
+// MQTT Client Control (defined with the MQTT client below)
+void handle_set_mqtt(JsonDocument &doc, JsonDocument &response);
+
+const CommandRoute command_routes[] = {
+    {"set_speed",           handle_set_speed},
+    {"set_fan1",            handle_set_fan1},
+    {"set_fan2",            handle_set_fan2},
+    {"set_fan1_color",      handle_set_fan1_color},
+    {"set_fan2_color",      handle_set_fan2_color},
+    {"set_fan1_brightness", handle_set_fan1_brightness},
+    {"set_fan2_brightness", handle_set_fan2_brightness},
+    {"set_argb_effect",     handle_set_argb_effect},
+    {"set_airflow_balance", handle_set_airflow_balance},
+    {"set_power_mode",      handle_set_power_mode},
+    {"set_telemetry",       handle_set_telemetry},
+    {"set_mqtt",            handle_set_mqtt},
+};
+
+// ====== MQTT CLIENT ======
+// Topics (base = <prefix>/<mac>):
+//   <base>/online           retained "1"/"0" (last will)
+//   <base>/telemetry        batched fan state, published on change beyond the
+//                           RPM deadband or at least every MQTT_MAX_INTERVAL_MS
+//   <base>/cmd/<name>       JSON commands, same payloads as POST /<name>
+//   <base>/response/<name>  handler response; an "id" field in the command is echoed
+// All MQTT work runs from loop(), so commands are applied between control ticks.
+
+// Settings staged by /set_mqtt (AsyncTCP task or MQTT callback). Only update_mqtt()
+// copies them into the loop-owned fields, under mqtt_config_mux.
+portMUX_TYPE mqtt_config_mux = portMUX_INITIALIZER_UNLOCKED;
+bool mqtt_config_pending = true;  // Apply broker settings on the next loop()
+bool mqtt_pending_enabled = MQTT_ENABLED_AT_BOOT;
+char mqtt_pending_host[MQTT_BROKER_HOST_MAX] = MQTT_BROKER_HOST;
+int mqtt_pending_port = MQTT_BROKER_PORT;
+
+bool mqtt_force_publish = true;
+unsigned long mqtt_last_connect_attempt = 0;
+unsigned long mqtt_last_publish = 0;
+uint32_t mqtt_telemetry_sequence = 0;
+TelemetrySnapshot mqtt_last_snapshot = {};
+uint8_t mqtt_last_effect = 0;
+
+void handle_set_mqtt(JsonDocument &doc, JsonDocument &response) {
+    // Called from both the AsyncTCP task and the MQTT callback, so only stage the
+    // new settings here - update_mqtt() applies them and reconnects from loop()
+    const char* broker = doc["broker"].as<const char*>();  // NULL when not given
+    if (broker != NULL && strlen(broker) >= MQTT_BROKER_HOST_MAX) {
+        response["success"] = false;
+        response["error"] = "broker name too long";
+        return;
+    }
+    
+    bool has_enabled = doc["enabled"].is<bool>();
+    bool has_port = doc["port"].is<int>();
+    bool enabled = doc["enabled"];
+    int port = doc["port"];
+    if (has_port && (port <= 0 || port > 65535)) {
+        response["success"] = false;
+        response["error"] = "port must be 1-65535";
+        return;
+    }
+    char host[MQTT_BROKER_HOST_MAX];
+    
+    portENTER_CRITICAL(&mqtt_config_mux);
+    if (has_enabled) mqtt_pending_enabled = enabled;
+    if (broker != NULL) strlcpy(mqtt_pending_host, broker, sizeof(mqtt_pending_host));
+    if (has_port) mqtt_pending_port = port;
+    mqtt_config_pending = true;
+    enabled = mqtt_pending_enabled;
+    strlcpy(host, mqtt_pending_host, sizeof(host));
+    port = mqtt_pending_port;
+    portEXIT_CRITICAL(&mqtt_config_mux);
+    
+    response["success"] = true;
+    response["enabled"] = enabled;
+    response["broker"] = host;
+    response["port"] = port;
+    response["base_topic"] = mqtt_base_topic;
+}
+
+// Shared by the HTTP routes and the MQTT callback so a bad payload is reported
+// the same way on both transports instead of running a handler on an empty doc
+void build_parse_error_response(DeserializationError error, JsonDocument &response) {
+    response["success"] = false;
+    response["error"] = error.c_str();
+}
+
+void mqtt_callback(char* topic, byte* payload, unsigned int length) {
+    String command_prefix = mqtt_base_topic + "/cmd/";
+    String topic_str = topic;
+    if (!topic_str.startsWith(command_prefix)) return;
+    String name = topic_str.substring(command_prefix.length());
+    
+    for (const CommandRoute &route : command_routes) {
+        if (name != route.name) continue;
+        
+        power_note_request();  // Commands count as activity, like HTTP requests
+        
+        JsonDocument doc;
+        JsonDocument response;
+        DeserializationError error = deserializeJson(doc, (const uint8_t*)payload, length);
+        
+        if (error) {
+            build_parse_error_response(error, response);
+        } else {
+            route.handler(doc, response);
+        }
+        if (doc.containsKey("id")) {
+            response["id"] = doc["id"];  // Lets clients correlate responses and measure latency
+        }
+        mqtt_command_count++;
+        
+        String response_str;
+        serializeJson(response, response_str);
+        mqtt_client.publish((mqtt_base_topic + "/response/" + name).c_str(), response_str.c_str());
+        return;
+    }
+    
+    Serial.printf("MQTT: unknown command topic %s\n", topic);
+}
+
+void init_mqtt() {
+    String mac = WiFi.macAddress();
+    mac.replace(":", "");
+    mac.toLowerCase();
+    mqtt_base_topic = String(MQTT_TOPIC_PREFIX) + "/" + mac;
+    
+    mqtt_client.setBufferSize(MQTT_BUFFER_SIZE);
+    mqtt_client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+    mqtt_client.setCallback(mqtt_callback);
+    
+    Serial.printf("MQTT base topic: %s (%s)\n", mqtt_base_topic.c_str(), mqtt_enabled ? "enabled" : "disabled");
+}
+
+bool connect_mqtt() {
+    mqtt_last_connect_attempt = millis();
+    
+    String client_id = "esp32-fan-" + mqtt_base_topic.substring(mqtt_base_topic.lastIndexOf('/') + 1);
+    String online_topic = mqtt_base_topic + "/online";
+    
+    if (!mqtt_broker_resolved) {
+        Serial.printf("MQTT broker %s could not be resolved\n", mqtt_broker_host);
+        return false;
+    }
+    
+    // Open the TCP connection ourselves with a short timeout - PubSubClient reuses an
+    // already connected client, and its own connect() would block loop() for the
+    // WiFiClient default (~3 s) on every retry while the broker is unreachable
+    if (!mqtt_wifi_client.connect(mqtt_broker_ip, mqtt_broker_port, MQTT_CONNECT_TIMEOUT_MS)) {
+        Serial.printf("MQTT broker %s:%d unreachable\n", mqtt_broker_host, mqtt_broker_port);
+        return false;
+    }
+    
+    if (!mqtt_client.connect(client_id.c_str(), online_topic.c_str(), 1, true, "0")) {
+        Serial.printf("MQTT connect to %s:%d failed (state %d)\n",
+                      mqtt_broker_host, mqtt_broker_port, mqtt_client.state());
+        mqtt_wifi_client.stop();
+        return false;
+    }
+    
+    mqtt_client.publish(online_topic.c_str(), "1", true);
+    mqtt_client.subscribe((mqtt_base_topic + "/cmd/+").c_str());
+    mqtt_force_publish = true;
+    
+    Serial.printf("MQTT connected to %s:%d\n", mqtt_broker_host, mqtt_broker_port);
+    return true;
+}
+
+void publish_mqtt_telemetry(const TelemetrySnapshot &now) {
+    JsonDocument doc;
+    doc["seq"] = mqtt_telemetry_sequence++;
+    doc["uptime"] = millis() / 1000;
+    doc["fan1_rpm"] = now.rpm[0];
+    doc["fan1_speed"] = now.duty[0];
+    doc["fan1_fault"] = now.fault[0];
+    doc["fan2_rpm"] = now.rpm[1];
+    doc["fan2_speed"] = now.duty[1];
+    doc["fan2_fault"] = now.fault[1];
+    doc["argb_effect"] = argb_effect;
+    
+    String payload;
+    serializeJson(doc, payload);
+    if (mqtt_client.publish((mqtt_base_topic + "/telemetry").c_str(), payload.c_str())) {
+        mqtt_published_count++;
+    }
+}
+
+bool mqtt_telemetry_changed(const TelemetrySnapshot &now) {
+    for (int fan = 0; fan < 2; fan++) {
+        if (abs((int)now.rpm[fan] - (int)mqtt_last_snapshot.rpm[fan]) > MQTT_RPM_DEADBAND) return true;
+        if (now.duty[fan] != mqtt_last_snapshot.duty[fan]) return true;
+        if (now.fault[fan] != mqtt_last_snapshot.fault[fan]) return true;
+    }
+    return argb_effect != mqtt_last_effect;
+}
+
+void update_mqtt() {
+    // MQTT needs a broker on the home network - nothing to do in AP mode
+    if (WiFi.status() != WL_CONNECTED) {
+        mqtt_is_connected = false;
+        return;
+    }
     
-    String json_string;
-    serializeJson(doc, json_string);
-    return json_string;
+    if (mqtt_config_pending) {
+        portENTER_CRITICAL(&mqtt_config_mux);
+        mqtt_config_pending = false;
+        mqtt_enabled = mqtt_pending_enabled;
+        strlcpy(mqtt_broker_host, mqtt_pending_host, sizeof(mqtt_broker_host));
+        mqtt_broker_port = mqtt_pending_port;
+        portEXIT_CRITICAL(&mqtt_config_mux);
+        
+        if (mqtt_client.connected()) {
+            mqtt_client.publish((mqtt_base_topic + "/online").c_str(), "0", true);
+            mqtt_client.disconnect();
+        }
+        
+        // Resolve once per settings change (DNS blocks; an IP literal returns at once)
+        // and hand PubSubClient the address by value rather than a string pointer
+        mqtt_broker_resolved = mqtt_enabled && WiFi.hostByName(mqtt_broker_host, mqtt_broker_ip) == 1;
+        mqtt_client.setServer(mqtt_broker_ip, mqtt_broker_port);
+        mqtt_last_connect_attempt = millis() - MQTT_RECONNECT_INTERVAL_MS;  // Connect right away
+    }
+    
+    if (!mqtt_enabled) {
+        mqtt_is_connected = false;
+        return;
+    }
+    
+    unsigned long current_time = millis();
+    if (!mqtt_client.connected()) {
+        if (current_time - mqtt_last_connect_attempt >= MQTT_RECONNECT_INTERVAL_MS) {
+            connect_mqtt();
+        }
+        mqtt_is_connected = mqtt_client.connected();
+        return;
+    }
+    
+    // Dispatches any pending commands through mqtt_callback()
+    mqtt_is_connected = mqtt_client.loop();
+    if (!mqtt_is_connected) return;
+    
+    // Batched, change-triggered telemetry
+    unsigned long since_publish = current_time - mqtt_last_publish;
+    if (!mqtt_force_publish && since_publish < MQTT_MIN_INTERVAL_MS) return;
+    
+    TelemetrySnapshot now = capture_telemetry_snapshot();
+    if (mqtt_force_publish || since_publish >= MQTT_MAX_INTERVAL_MS || mqtt_telemetry_changed(now)) {
+        publish_mqtt_telemetry(now);
+        mqtt_last_snapshot = now;
+        mqtt_last_effect = argb_effect;
+        mqtt_last_publish = current_time;
+        mqtt_force_publish = false;
+    }
 }
 
 void init_web_server() {
@@ -437,6 +1705,8 @@ void init_web_server() {
     
     // Serve main control page
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admit_request(request, ROUTE_READ)) return;
+        
         String html = "<!DOCTYPE html><html><head><title>ESP32 Fan Controller</title><style>"
             "body{font-family:Arial,sans-serif;background:linear-gradient(135deg,#1e3c72 0%,#2a5298 100%);color:white;padding:20px;margin:0}"
             ".container{max-width:800px;margin:0 auto;background:rgba(255,255,255,0.1);border-radius:15px;padding:25px;box-shadow:0 8px 32px rgba(0,0,0,0.3)}"
@@ -550,192 +1820,60 @@ void init_web_server() {
     
     // API endpoint to get current status
     server.on("/status", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(200, "application/json", get_status_json());
+        if (!admit_request(request, ROUTE_READ)) return;
+        
+        JsonDocument doc;
+        build_status_doc(doc);
+        send_document(request, doc);
     });
     
-    // API endpoint to set fan speeds (dual fan support)
-    server.on("/set_speed", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL, 
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            JsonDocument response;
-            response["success"] = true;
-            
-            // Handle legacy single fan control (defaults to Fan 1)
-            if (doc.containsKey("speed")) {
-                int speed = doc["speed"];
-                set_fan1_speed(speed);
-                response["speed"] = speed;
-                response["fan"] = "fan1";
-            }
-            
-            // Handle individual fan control
-            if (doc.containsKey("fan1_speed")) {
-                int speed = doc["fan1_speed"];
-                set_fan1_speed(speed);
-                response["fan1_speed"] = speed;
-            }
-            
-            if (doc.containsKey("fan2_speed")) {
-                int speed = doc["fan2_speed"];
-                set_fan2_speed(speed);
-                response["fan2_speed"] = speed;
-            }
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-    
-    // API endpoint for individual fan control
-    server.on("/set_fan1", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            int speed = doc["speed"];
-            set_fan1_speed(speed);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan1";
-            response["speed"] = speed;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
+    // Settings, calibration and counters (polled far less often than /status)
+    server.on("/diagnostics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admit_request(request, ROUTE_READ)) return;
         
-    server.on("/set_fan2", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            int speed = doc["speed"];
-            set_fan2_speed(speed);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan2";
-            response["speed"] = speed;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-
-    // ====== ARGB CONTROL ENDPOINTS ======
-    
-    // Fan 1 ARGB Color Control
-    server.on("/set_fan1_color", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            uint8_t red = doc["red"];
-            uint8_t green = doc["green"];
-            uint8_t blue = doc["blue"];
-            
-            set_fan1_color(red, green, blue);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan1";
-            response["red"] = red;
-            response["green"] = green; 
-            response["blue"] = blue;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-    
-    // Fan 2 ARGB Color Control  
-    server.on("/set_fan2_color", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            uint8_t red = doc["red"];
-            uint8_t green = doc["green"];
-            uint8_t blue = doc["blue"];
-            
-            set_fan2_color(red, green, blue);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan2";
-            response["red"] = red;
-            response["green"] = green;
-            response["blue"] = blue;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-
-    // Fan 1 Brightness Control
-    server.on("/set_fan1_brightness", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            int brightness_percent = doc["brightness"];
-            uint8_t brightness = (brightness_percent * 255) / 100;  // Convert percentage to 0-255
-            
-            set_fan1_brightness(brightness);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan1";
-            response["brightness"] = brightness_percent;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-
-    // Fan 2 Brightness Control
-    server.on("/set_fan2_brightness", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            int brightness_percent = doc["brightness"];
-            uint8_t brightness = (brightness_percent * 255) / 100;  // Convert percentage to 0-255
-            
-            set_fan2_brightness(brightness);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["fan"] = "fan2";  
-            response["brightness"] = brightness_percent;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
-
-    // ARGB Effect Control
-    server.on("/set_argb_effect", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
-        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-            JsonDocument doc;
-            deserializeJson(doc, data);
-            
-            int effect = doc["effect"];
-            argb_effect = effect;
-            
-            Serial.printf("ARGB effect changed to: %d\n", effect);
-            
-            JsonDocument response;
-            response["success"] = true;
-            response["effect"] = effect;
-            
-            String response_str;
-            serializeJson(response, response_str);
-            request->send(200, "application/json", response_str);
-        });
+        JsonDocument doc;
+        build_diagnostics_doc(doc);
+        send_document(request, doc);
+    });
+    
+    // Takes no arguments, so it answers from the request handler - with or without a body
+    server.on("/reset_stats", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (!admit_request(request, ROUTE_WRITE)) return;
+        
+        JsonDocument response;
+        handle_reset_stats(response);
+        send_document(request, response);
+    });
+    
+    // Control endpoints - one POST route per entry in command_routes. The body
+    // handler answers; the request handler only sees requests that never had one.
+    for (const CommandRoute &route : command_routes) {
+        CommandHandler handler = route.handler;
+        server.on((String("/") + route.name).c_str(), HTTP_POST, [](AsyncWebServerRequest *request) {
+                if (request->contentLength() != 0) return;
+                if (!admit_request(request, ROUTE_WRITE)) return;
+                
+                JsonDocument response;
+                build_parse_error_response(DeserializationError::EmptyInput, response);
+                send_document(request, response, 400);
+            }, NULL,
+            [handler](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+                if (index != 0) return;  // Control payloads fit in the first body chunk
+                if (!admit_request(request, ROUTE_WRITE)) return;
+                
+                JsonDocument doc;
+                JsonDocument response;
+                DeserializationError error = parse_request_body(request, doc, data, len);
+                if (error) {
+                    build_parse_error_response(error, response);
+                    send_document(request, response, 400);
+                    return;
+                }
+                
+                handler(doc, response);
+                send_document(request, response);
+            });
+    }
     
     server.begin();
     Serial.printf("Web Server started on http://%s\n", WiFi.localIP().toString().c_str());
@@ -746,6 +1884,8 @@ void setup() {
     Serial.begin(115200);
     delay(1000);
     
+    loop_task_handle = xTaskGetCurrentTaskHandle();  // setup() and loop() share the Arduino loop task
+    
     Serial.println("ESP32 Web Fan Controller Starting...");
     Serial.println("Board #1 - MAC: Expected 44:1d:64:f5:b4:84");
     Serial.println("🔧 GPIO PIN ASSIGNMENTS (Updated for reliable PWM):");
@@ -777,6 +1917,16 @@ void setup() {
         
         Serial.println("Fan Control: Use web interface for 0-100% control");
         Serial.println("RPM Monitoring: Real-time tacho feedback");
+        if (telemetry_enabled) {
+            set_telemetry(true, telemetry_rate_hz);
+        }
+        init_mqtt();
+        
+        // Start at full performance - idle mode is entered from loop() once quiet
+        apply_power_state(POWER_PERFORMANCE, false);
+        if (power_save_enabled) {
+            set_power_save(true, power_idle_timeout_ms);
+        }
         Serial.println();
     } else {
         Serial.println("System Error: No WiFi connection available");
@@ -784,12 +1934,29 @@ void setup() {
 }
 
 void loop() {
+    unsigned long tick_start_us = micros();
+    loop_timing_tick_start(tick_start_us);
+    
     // Measure RPM continuously
     measure_rpm();
     
+    // Drive both fans together when airflow balancing is active
+    update_airflow_balance();
+    
     // Update ARGB LED effects
     update_argb_leds();
     
-    // Small delay to prevent overwhelming the system
-    delay(100);
+    // Stream UDP telemetry (no-op unless enabled)
+    update_telemetry();
+    
+    // Service MQTT connection, commands and telemetry (no-op unless enabled)
+    update_mqtt();
+    
+    // Drop to idle / return to full performance as activity and faults dictate
+    update_power_mode();
+    
+    // Wait for the next control tick - an HTTP request while idle ends the wait early
+    unsigned long tick_ms = control_tick_ms();
+    loop_timing_tick_end(tick_start_us, tick_ms);
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(tick_ms));
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#!/usr/bin/env python3
+"""
+Compare JSON vs MessagePack encoding of the /status payload
+Runs offline against a representative status document, and optionally
+against a live board (--host) using Accept-header negotiation. With --host
+the offline comparison uses the board's own /status instead of the sample.
+"""
+
+import argparse
+import json
+import time
+import sys
+
+try:
+    import msgpack
+except ImportError:
+    print("❌ msgpack module not found - install with: pip install msgpack")
+    sys.exit(1)
+
+# Same keys and typical values as build_status_doc() in src/main.cpp
+SAMPLE_STATUS = {
+    "fan1_speed": 40,
+    "fan1_rpm": 1200,
+    "fan2_speed": 70,
+    "fan2_rpm": 2100,
+    "uptime": 3600,
+    "board_mac": "44:1D:64:F5:B4:84",
+    "fan1_red": 255,
+    "fan1_green": 0,
+    "fan1_blue": 0,
+    "fan1_brightness": 19,
+    "fan2_red": 0,
+    "fan2_green": 0,
+    "fan2_blue": 255,
+    "fan2_brightness": 19,
+    "argb_effect": 0,
+    "fan1_fault": 0,
+    "fan2_fault": 0,
+    "fan1_airflow_cfm": 31.30435,
+    "fan2_airflow_cfm": 54.78261,
+    "balance_active": False,
+    "balance_target_met": False,
+    "power_state": "performance",
+    "cpu_mhz": 240,
+    "mqtt_connected": False,
+    "fan_speed": 40,
+    "fan_rpm": 1200,
+    "wifi_mode": "Station",
+    "wifi_network": "HareNet",
+    "wifi_signal": -65,
+    "ip_address": "10.0.1.146",
+    "connected_clients": "N/A",
+}
+
+def time_call(func, iterations):
+    start = time.perf_counter()
+    for _ in range(iterations):
+        func()
+    return (time.perf_counter() - start) / iterations * 1e6  # µs per call
+
+def fetch_live_status(host):
+    import requests
+
+    response = requests.get(f"http://{host}/status", headers={"Accept": "application/json"}, timeout=3)
+    response.raise_for_status()
+    return response.json()
+
+def benchmark_offline(status, source, iterations):
+    json_bytes = json.dumps(status, separators=(",", ":")).encode()
+    msgpack_bytes = msgpack.packb(status)
+
+    print(f"📦 Payload size ({source} /status document, {len(status)} keys)")
+    print(f"   JSON:        {len(json_bytes):4d} bytes")
+    print(f"   MessagePack: {len(msgpack_bytes):4d} bytes "
+          f"({100.0 * len(msgpack_bytes) / len(json_bytes):.0f}% of JSON)")
+    print()
+
+    print(f"⏱️  Host encode/decode time ({iterations} iterations)")
+    print(f"   JSON encode:        {time_call(lambda: json.dumps(status, separators=(',', ':')), iterations):6.2f} µs")
+    print(f"   MessagePack encode: {time_call(lambda: msgpack.packb(status), iterations):6.2f} µs")
+    print(f"   JSON decode:        {time_call(lambda: json.loads(json_bytes), iterations):6.2f} µs")
+    print(f"   MessagePack decode: {time_call(lambda: msgpack.unpackb(msgpack_bytes), iterations):6.2f} µs")
+
+def benchmark_live(host, requests_count):
+    import requests
+
+    print()
+    print(f"🌐 Live comparison against http://{host}/status ({requests_count} requests each)")
+    variants = [
+        ("JSON", "application/json", lambda body: json.loads(body)),
+        ("MessagePack", "application/msgpack", lambda body: msgpack.unpackb(body)),
+    ]
+    for name, accept, decode in variants:
+        sizes = []
+        decode_us = 0.0
+        start = time.perf_counter()
+        for _ in range(requests_count):
+            response = requests.get(f"http://{host}/status", headers={"Accept": accept}, timeout=3)
+            sizes.append(len(response.content))
+            t0 = time.perf_counter()
+            decode(response.content)
+            decode_us += (time.perf_counter() - t0) * 1e6
+        elapsed_ms = (time.perf_counter() - start) * 1000 / requests_count
+        print(f"   {name:12s} {sum(sizes) / len(sizes):6.1f} bytes | "
+              f"{elapsed_ms:6.1f} ms/request | {decode_us / requests_count:6.2f} µs decode | "
+              f"Content-Type: {response.headers.get('Content-Type')}")
+
+def main():
+    parser = argparse.ArgumentParser(description="JSON vs MessagePack /status benchmark")
+    parser.add_argument("--host", help="ESP32 IP address for a live comparison (optional)")
+    parser.add_argument("--iterations", type=int, default=20000, help="Offline iterations")
+    parser.add_argument("--requests", type=int, default=50, help="Live requests per encoding")
+    args = parser.parse_args()
+
+    if args.host:
+        benchmark_offline(fetch_live_status(args.host), "live", args.iterations)
+        benchmark_live(args.host, args.requests)
+    else:
+        benchmark_offline(SAMPLE_STATUS, "representative", args.iterations)
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+"""
+UDP Telemetry Receiver / Aggregator for ESP32 Dual Fan Controllers
+Joins the telemetry multicast group, decodes the delta-encoded datagrams
+from every board and reports per-board loss and throughput.
+
+Run with --simulate N to spawn N local simulated senders (same wire format
+as update_telemetry() in src/main.cpp) for testing without hardware.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import threading
+import time
+
+# Must match the TELEMETRY_* defines in src/main.cpp
+MULTICAST_GROUP = "239.255.70.1"
+PORT = 5005
+PROTOCOL_VERSION = 1
+KEYFRAME_INTERVAL = 10
+FLAG_KEYFRAME = 0x01
+HEADER = struct.Struct("<2sBBIIBB")  # magic, version, flags, seq, uptime_ms, since_keyframe, mask
+FIELDS = [("rpm", 0), ("duty", 0), ("fault", 0), ("rpm", 1), ("duty", 1), ("fault", 1)]
+FAULT_STALL = 0x01
+
+def encode_datagram(seq, uptime_ms, since_keyframe, now, keyframe_state):
+    """Encode one datagram; now/keyframe_state are dicts of (field, fan) -> value"""
+    keyframe = since_keyframe == 0
+    mask = 0
+    body = b""
+    for bit, key in enumerate(FIELDS):
+        if not keyframe and now[key] == keyframe_state[key]:
+            continue
+        mask |= 1 << bit
+        if key[0] == "rpm":
+            body += struct.pack("<H", now[key]) if keyframe else struct.pack("<h", now[key] - keyframe_state[key])
+        else:
+            body += struct.pack("<B", now[key])
+    header = HEADER.pack(b"FT", PROTOCOL_VERSION, FLAG_KEYFRAME if keyframe else 0,
+                         seq, uptime_ms, since_keyframe, mask)
+    return header + body
+
+class BoardState:
+    """Decoder and statistics for one sending board"""
+
+    def __init__(self, address):
+        self.address = address
+        self.keyframe_seq = None
+        self.keyframe = {}
+        self.values = {}
+        self.first_seq = None
+        self.last_seq = None
+        self.last_uptime_ms = None
+        self.received = 0
+        self.undecodable = 0
+        self.bytes = 0
+        self.window_received = 0
+        self.window_bytes = 0
+
+    def handle(self, data):
+        if len(data) < HEADER.size:
+            return
+        magic, version, flags, seq, uptime_ms, since_keyframe, mask = HEADER.unpack_from(data)
+        if magic != b"FT" or version != PROTOCOL_VERSION:
+            return
+
+        # seq going backwards is either a reordered datagram (sent up to a second
+        # before the newest one) or a reboot, however early in the previous run
+        rebooted = (self.first_seq is not None and seq < self.last_seq and
+                    not self.last_uptime_ms - 1000 <= uptime_ms <= self.last_uptime_ms)
+        if self.first_seq is None or rebooted:
+            # First datagram or board rebooted - restart statistics and decoder state
+            self.first_seq = seq
+            self.last_seq = seq
+            self.received = 0
+            self.undecodable = 0
+            self.bytes = 0
+            self.keyframe_seq = None
+            self.keyframe = {}
+            self.values = {}
+        if seq >= self.last_seq:
+            self.last_seq = seq
+            self.last_uptime_ms = uptime_ms
+        self.received += 1
+        self.bytes += len(data)
+        self.window_received += 1
+        self.window_bytes += len(data)
+
+        keyframe = bool(flags & FLAG_KEYFRAME)
+        if not keyframe and self.keyframe_seq != seq - since_keyframe:
+            self.undecodable += 1  # Its keyframe was lost - wait for the next one
+            return
+
+        decoded = dict(self.keyframe) if not keyframe else {}
+        pos = HEADER.size
+        for bit, key in enumerate(FIELDS):
+            if not mask & (1 << bit):
+                continue
+            if key[0] == "rpm":
+                if keyframe:
+                    (decoded[key],) = struct.unpack_from("<H", data, pos)
+                else:
+                    (delta,) = struct.unpack_from("<h", data, pos)
+                    decoded[key] = self.keyframe[key] + delta
+                pos += 2
+            else:
+                decoded[key] = data[pos]
+                pos += 1
+
+        if keyframe:
+            self.keyframe_seq = seq
+            self.keyframe = dict(decoded)
+        self.values = decoded
+
+    def expected(self):
+        return 0 if self.first_seq is None else self.last_seq - self.first_seq + 1
+
+    def loss_percent(self):
+        expected = self.expected()
+        return 0.0 if expected == 0 else 100.0 * (expected - self.received) / expected
+
+def run_simulated_sender(index, target, rate_hz, drop_percent, stop_event):
+    """Emulates one board: fans ramp slowly, RPM updates once per second"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+
+    seq = 0
+    since_keyframe = 0
+    keyframe_state = {}
+    start = time.monotonic()
+    next_send = start
+    duty = [40 + index % 30, 70 - index % 30]
+    rpm = [0, 0]
+    last_rpm_update = -1
+
+    while not stop_event.is_set():
+        now_s = time.monotonic()
+        if int(now_s - start) != last_rpm_update:
+            last_rpm_update = int(now_s - start)
+            if random.random() < 0.1:
+                duty[random.randrange(2)] = random.choice(range(0, 101, 10))
+            rpm = [int(d * 23 + random.randint(-30, 30)) if d else 0 for d in duty]
+
+        now = {}
+        for fan in range(2):
+            now[("rpm", fan)] = max(rpm[fan], 0)
+            now[("duty", fan)] = duty[fan]
+            now[("fault", fan)] = FAULT_STALL if duty[fan] >= 20 and rpm[fan] == 0 else 0
+
+        packet = encode_datagram(seq, int((now_s - start) * 1000) & 0xFFFFFFFF,
+                                 since_keyframe, now, keyframe_state)
+        if since_keyframe == 0:
+            keyframe_state = now
+        if random.uniform(0, 100) >= drop_percent:
+            sock.sendto(packet, (target, PORT))
+
+        seq += 1
+        since_keyframe = (since_keyframe + 1) % KEYFRAME_INTERVAL
+        next_send += 1.0 / rate_hz
+        time.sleep(max(0.0, next_send - time.monotonic()))
+
+def open_receiver_socket(group):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", PORT))
+    membership = struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton("0.0.0.0"))
+    try:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+    except OSError as e:
+        print(f"⚠️  Could not join multicast group {group} ({e}) - receiving unicast only")
+    sock.settimeout(0.2)
+    return sock
+
+def print_report(boards, window_s):
+    print("=" * 78)
+    print(f"{'Board':<22}{'Pkts/s':>8}{'B/s':>8}{'Loss%':>8}{'Undec':>7}  "
+          f"{'F1 rpm/duty/flt':>16}  {'F2 rpm/duty/flt':>16}")
+    total_pps = total_bps = 0.0
+    for address, board in sorted(boards.items()):
+        pps = board.window_received / window_s
+        bps = board.window_bytes / window_s
+        total_pps += pps
+        total_bps += bps
+        fans = []
+        for fan in range(2):
+            v = board.values
+            fans.append(f"{v.get(('rpm', fan), '-')}/{v.get(('duty', fan), '-')}/{v.get(('fault', fan), '-')}")
+        print(f"{address:<22}{pps:8.1f}{bps:8.0f}{board.loss_percent():8.2f}{board.undecodable:7d}  "
+              f"{fans[0]:>16}  {fans[1]:>16}")
+        board.window_received = 0
+        board.window_bytes = 0
+    print(f"{'TOTAL (' + str(len(boards)) + ' boards)':<22}{total_pps:8.1f}{total_bps:8.0f}")
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 fan controller UDP telemetry receiver")
+    parser.add_argument("--group", default=MULTICAST_GROUP, help="Multicast group to join")
+    parser.add_argument("--interval", type=float, default=2.0, help="Report interval in seconds")
+    parser.add_argument("--duration", type=float, default=0, help="Stop after N seconds (0 = run forever)")
+    parser.add_argument("--simulate", type=int, default=0, help="Spawn N local simulated senders")
+    parser.add_argument("--sim-rate", type=float, default=10.0, help="Simulated datagrams per second per board")
+    parser.add_argument("--sim-drop", type=float, default=0.0, help="Simulated packet drop percentage")
+    parser.add_argument("--sim-target", default=None, help="Simulated destination (default: multicast group)")
+    args = parser.parse_args()
+
+    print("📡 ESP32 Fan Controller Telemetry Receiver")
+    print(f"Group: {args.group}:{PORT}")
+
+    sock = open_receiver_socket(args.group)
+    stop_event = threading.Event()
+    senders = []
+    for i in range(args.simulate):
+        target = args.sim_target or args.group
+        thread = threading.Thread(target=run_simulated_sender,
+                                  args=(i, target, args.sim_rate, args.sim_drop, stop_event), daemon=True)
+        thread.start()
+        senders.append(thread)
+    if senders:
+        print(f"🧪 Simulating {args.simulate} boards @ {args.sim_rate} Hz, {args.sim_drop}% drop")
+
+    boards = {}
+    start = time.monotonic()
+    last_report = start
+    try:
+        while args.duration == 0 or time.monotonic() - start < args.duration:
+            try:
+                data, (ip, port) = sock.recvfrom(256)
+                # Simulated boards share an IP - tell them apart by source port
+                address = f"{ip}:{port}" if args.simulate else ip
+                boards.setdefault(address, BoardState(address)).handle(data)
+            except socket.timeout:
+                pass
+            now = time.monotonic()
+            if now - last_report >= args.interval:
+                print_report(boards, now - last_report)
+                last_report = now
+    except KeyboardInterrupt:
+        print("\n👋 Receiver stopped by user")
+    finally:
+        stop_event.set()
+        sock.close()
+
+    print()
+    print("📊 Summary")
+    for address, board in sorted(boards.items()):
+        print(f"   {address:<22} received {board.received}/{board.expected()} "
+              f"({board.loss_percent():.2f}% loss, {board.undecodable} undecodable, "
+              f"{board.bytes / max(board.received, 1):.1f} bytes avg)")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+"""
+Web Server Load Test for ESP32 Dual Fan Controller
+Floods /status and /set_fan1_color like a misbehaving dashboard, then compares
+the board's control loop timing (loop_late_*, loop_work_max_us in /diagnostics)
+against a quiet baseline and reports how admission control responded.
+"""
+
+import argparse
+import threading
+import time
+from collections import Counter
+
+import requests
+
+def fetch(host, path):
+    # The flood drains this client's buckets - wait out Retry-After if needed
+    for _ in range(10):
+        response = requests.get(f"http://{host}{path}", timeout=5)
+        if response.status_code == 200:
+            return response.json()
+        time.sleep(int(response.headers.get("Retry-After", "1")))
+    raise RuntimeError(f"{path} kept rejecting requests")
+
+def reset_stats(host):
+    requests.post(f"http://{host}/reset_stats", timeout=5).raise_for_status()
+
+def flood_worker(host, stop_event, read_ratio, color, results, lock):
+    session = requests.Session()
+    counter = 0
+    while not stop_event.is_set():
+        counter += 1
+        start = time.perf_counter()
+        try:
+            if (counter % 100) < read_ratio * 100:
+                response = session.get(f"http://{host}/status", timeout=3)
+            else:
+                response = session.post(f"http://{host}/set_fan1_color", json=color, timeout=3)
+            outcome = response.status_code
+        except requests.RequestException:
+            outcome = "error"
+        latency_ms = (time.perf_counter() - start) * 1000
+        with lock:
+            results["codes"][outcome] += 1
+            results["latencies"].append(latency_ms)
+
+def print_loop_stats(name, diagnostics):
+    print(f"   {name:<10} late max {diagnostics['loop_late_max_us'] / 1000:7.2f} ms | "
+          f"late avg {diagnostics['loop_late_avg_us'] / 1000:6.2f} ms | "
+          f"work max {diagnostics['loop_work_max_us'] / 1000:6.2f} ms")
+
+def main():
+    parser = argparse.ArgumentParser(description="ESP32 fan controller web load test")
+    parser.add_argument("host", help="ESP32 IP address")
+    parser.add_argument("--threads", type=int, default=8, help="Concurrent flooding clients")
+    parser.add_argument("--duration", type=float, default=20.0, help="Flood duration in seconds")
+    parser.add_argument("--read-ratio", type=float, default=0.7, help="Fraction of /status requests")
+    parser.add_argument("--jitter-limit-ms", type=float, default=20.0, help="Acceptable extra loop lateness")
+    args = parser.parse_args()
+
+    initial = fetch(args.host, "/status")
+    color = {"red": initial["fan1_red"], "green": initial["fan1_green"], "blue": initial["fan1_blue"]}
+
+    print(f"🔨 Web load test against {args.host}")
+    print("=" * 70)
+
+    # Quiet baseline
+    reset_stats(args.host)
+    print(f"⏳ Measuring quiet baseline for {args.duration / 2:.0f}s...")
+    time.sleep(args.duration / 2)
+    baseline = fetch(args.host, "/diagnostics")
+
+    # Flood (re-sending the current Fan 1 color, so the LEDs don't change)
+    reset_stats(args.host)
+    print(f"🌊 Flooding with {args.threads} threads for {args.duration:.0f}s...")
+    results = {"codes": Counter(), "latencies": []}
+    lock = threading.Lock()
+    stop_event = threading.Event()
+    threads = [threading.Thread(target=flood_worker,
+                                args=(args.host, stop_event, args.read_ratio, color, results, lock))
+               for _ in range(args.threads)]
+    for thread in threads:
+        thread.start()
+    time.sleep(args.duration)
+    stop_event.set()
+    for thread in threads:
+        thread.join()
+    time.sleep(3)  # Let the buckets refill before reading stats
+    flood = fetch(args.host, "/diagnostics")
+
+    total = sum(results["codes"].values())
+    latencies = sorted(results["latencies"])
+    print()
+    print("📊 Client view")
+    print(f"   Requests: {total} ({total / args.duration:.1f}/s)")
+    for code, count in sorted(results["codes"].items(), key=lambda item: str(item[0])):
+        print(f"   {code}: {count} ({100.0 * count / total:.1f}%)")
+    if latencies:
+        print(f"   Latency median {latencies[len(latencies) // 2]:.1f} ms | "
+              f"p95 {latencies[int(len(latencies) * 0.95)]:.1f} ms")
+
+    print()
+    print("🛡️  Admission control (board counters)")
+    print(f"   Admitted {flood['admission_admitted']} | busy (503) {flood['admission_rejected_busy']} | "
+          f"rate limited reads {flood['admission_rejected_read']} / writes {flood['admission_rejected_write']}")
+
+    print()
+    print("⏱️  Control loop timing")
+    print_loop_stats("baseline", baseline)
+    print_loop_stats("flood", flood)
+    extra_ms = (flood["loop_late_max_us"] - baseline["loop_late_max_us"]) / 1000
+    if extra_ms <= args.jitter_limit_ms:
+        print(f"✅ Loop lateness bounded: +{extra_ms:.2f} ms over baseline (limit {args.jitter_limit_ms} ms)")
+    else:
+        print(f"❌ Loop lateness grew by {extra_ms:.2f} ms over baseline (limit {args.jitter_limit_ms} ms)")
+
+if __name__ == "__main__":
+    main()